@@ -0,0 +1,238 @@
+/* Copyright (C) 2013-2026 Emanuele Giaquinta
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation; either version 2, or (at your option) any
+   later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#include "automorphism.h"
+#include "dfg.h"
+#include "intset.h"
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+Automorphisms::Automorphisms(const DFG &dfg, unsigned budget)
+    : dfg_(&dfg)
+    , budget_(budget)
+{
+    int n = dfg.num_nodes();
+    // the initial colors are the classes of nodes with the same weight
+    // and forbidden flag
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    auto key = [&dfg](int u) {
+        return std::make_pair(dfg.is_forbidden(u), dfg.weight(u));
+    };
+    std::sort(order.begin(), order.end(), [&key](int u, int v) {
+        return key(u) < key(v);
+    });
+    Coloring colors(n);
+    for (int k = 1; k < n; k++)
+        colors[order[k]] =
+            colors[order[k - 1]] + (key(order[k - 1]) < key(order[k]));
+    if (n > 0)
+        first_path(std::move(colors));
+}
+
+// split the cells until the nodes of a cell have the same number of
+// predecessors and successors in each cell. The new colors are ordered
+// by the old colors and then by the counts, so that they do not depend
+// on the numbering of the nodes.
+void Automorphisms::refine(Coloring &colors) const
+{
+    int n = colors.size();
+    int num_colors = *std::max_element(colors.begin(), colors.end()) + 1;
+    std::vector<std::vector<int>> keys(n);
+    std::vector<int> order(n);
+    while (num_colors < n) {
+        for (int u = 0; u < n; u++) {
+            auto &k = keys[u];
+            k.assign(1, colors[u]);
+            for (auto &v : dfg_->out_edges(u))
+                k.push_back(colors[v]);
+            std::sort(k.begin() + 1, k.end());
+            k.push_back(-1);
+            size_t mid = k.size();
+            for (auto &v : dfg_->in_edges(u))
+                k.push_back(colors[v]);
+            std::sort(k.begin() + mid, k.end());
+        }
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&keys](int u, int v) {
+            return keys[u] < keys[v];
+        });
+        int c = 0;
+        for (int k = 0; k < n; k++) {
+            if (k > 0 && keys[order[k - 1]] != keys[order[k]])
+                c++;
+            colors[order[k]] = c;
+        }
+        if (c + 1 == num_colors)
+            break;
+        num_colors = c + 1;
+    }
+}
+
+// give u a color of its own, before the other nodes of its cell
+Automorphisms::Coloring Automorphisms::individualize(const Coloring &colors,
+                                                     int u)
+{
+    Coloring out(colors);
+    for (auto &c : out)
+        if (c >= colors[u])
+            c++;
+    out[u] = colors[u];
+    return out;
+}
+
+std::vector<int> Automorphisms::cell_sizes(const Coloring &colors)
+{
+    std::vector<int> sizes(colors.size());
+    for (auto c : colors)
+        sizes[c]++;
+    return sizes;
+}
+
+// the nodes of the first cell with more than one node
+std::vector<int> Automorphisms::target_cell(const Coloring &colors)
+{
+    auto sizes = cell_sizes(colors);
+    int target = -1;
+    for (int c = 0; c < sizes.size() && target == -1; c++)
+        if (sizes[c] > 1)
+            target = c;
+    std::vector<int> cell;
+    for (int u = 0; u < colors.size(); u++)
+        if (colors[u] == target)
+            cell.push_back(u);
+    return cell;
+}
+
+bool Automorphisms::is_automorphism(const Permutation &p) const
+{
+    for (int u = 0; u < dfg_->num_nodes(); u++) {
+        int v = p[u];
+        if (dfg_->weight(u) != dfg_->weight(v) ||
+            dfg_->is_forbidden(u) != dfg_->is_forbidden(v) ||
+            dfg_->out_edges(u).size() != dfg_->out_edges(v).size())
+            return false;
+        auto &edges = dfg_->out_edges(v);
+        for (auto &w : dfg_->out_edges(u))
+            if (std::find(edges.begin(), edges.end(), p[w]) == edges.end())
+                return false;
+    }
+    return true;
+}
+
+void Automorphisms::first_path(Coloring colors)
+{
+    budget_--;
+    refine(colors);
+    auto cell = target_cell(colors);
+    first_sizes_.push_back(cell_sizes(colors));
+    if (cell.empty()) {
+        first_leaf_.resize(colors.size());
+        for (int u = 0; u < colors.size(); u++)
+            first_leaf_[colors[u]] = u;
+        return;
+    }
+    unsigned level = first_sizes_.size() - 1;
+    unsigned num_generators = generators_.size();
+    first_path(individualize(colors, cell[0]));
+
+    // the generators found below this node fix the nodes individualized
+    // above it, their orbits on the cell are the children to skip
+    int n = colors.size();
+    std::vector<int> parent(n);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&parent](int u) {
+        while (parent[u] != u)
+            u = parent[u] = parent[parent[u]];
+        return u;
+    };
+    auto join = [&](unsigned first) {
+        for (unsigned g = first; g < generators_.size(); g++)
+            for (int u = 0; u < n; u++)
+                parent[find(u)] = find(generators_[g][u]);
+    };
+    join(num_generators);
+    for (unsigned k = 1; k < cell.size() && budget_ > 0; k++) {
+        if (find(cell[k]) == find(cell[0]))
+            continue;
+        unsigned first = generators_.size();
+        if (search(individualize(colors, cell[k]), level + 1))
+            join(first);
+    }
+}
+
+// true if a discrete coloring below 'colors' gives an automorphism
+bool Automorphisms::search(Coloring colors, unsigned level)
+{
+    if (budget_ == 0)
+        return false;
+    budget_--;
+    refine(colors);
+    if (cell_sizes(colors) != first_sizes_[level])
+        return false;
+    auto cell = target_cell(colors);
+    if (cell.empty()) {
+        Permutation p(colors.size());
+        for (int u = 0; u < colors.size(); u++)
+            p[first_leaf_[colors[u]]] = u;
+        if (!is_automorphism(p))
+            return false;
+        generators_.push_back(std::move(p));
+        return true;
+    }
+    for (auto u : cell)
+        if (search(individualize(colors, u), level + 1))
+            return true;
+    return false;
+}
+
+intset Automorphisms::apply(const Permutation &p, const intset &s)
+{
+    intset out(s.max_size());
+    for (auto u : s)
+        out.add(p[u]);
+    return out;
+}
+
+std::vector<std::pair<intset, Automorphisms::Permutation>>
+Automorphisms::orbit(const intset &s) const
+{
+    Permutation identity(dfg_->num_nodes());
+    std::iota(identity.begin(), identity.end(), 0);
+    std::vector<std::pair<intset, Permutation>> out;
+    out.emplace_back(s, identity);
+    std::unordered_multimap<size_t, unsigned> index;
+    index.emplace(s.hash(), 0);
+    for (unsigned k = 0; k < out.size(); k++) {
+        for (auto &g : generators_) {
+            auto image = apply(g, out[k].first);
+            size_t h = image.hash();
+            auto range = index.equal_range(h);
+            if (std::any_of(range.first, range.second, [&](auto &entry) {
+                    return out[entry.second].first == image;
+                }))
+                continue;
+            Permutation p(g.size());
+            for (int u = 0; u < g.size(); u++)
+                p[u] = g[out[k].second[u]];
+            index.emplace(h, out.size());
+            out.emplace_back(std::move(image), std::move(p));
+        }
+    }
+    return out;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "dfg.h"
+#include "intset.h"
+#include <utility>
+#include <vector>
+
+// Generators of the automorphism group of a graph, the permutations of
+// the nodes that preserve the edges, the weights and the forbidden
+// nodes. The search individualizes one node at a time and refines the
+// coloring of the nodes by the colors of their predecessors and
+// successors. The first discrete coloring is compared with the others,
+// and the children of the nodes on the first path that are in the same
+// orbit as an explored child are skipped (McKay). The search visits at
+// most 'budget' colorings, so the group may be a subgroup of the full
+// group of a large graph.
+class Automorphisms {
+public:
+    Automorphisms(const DFG &dfg, unsigned budget = 100000);
+
+    using Permutation = std::vector<int>;
+
+    const std::vector<Permutation> &generators() const { return generators_; }
+    // the images of s under the group, each with an automorphism that
+    // maps s to it, starting with s itself
+    std::vector<std::pair<intset, Permutation>> orbit(const intset &s) const;
+
+    static intset apply(const Permutation &p, const intset &s);
+
+private:
+    using Coloring = std::vector<int>;
+
+    void refine(Coloring &colors) const;
+    static Coloring individualize(const Coloring &colors, int u);
+    static std::vector<int> cell_sizes(const Coloring &colors);
+    static std::vector<int> target_cell(const Coloring &colors);
+    bool is_automorphism(const Permutation &p) const;
+    void first_path(Coloring colors);
+    bool search(Coloring colors, unsigned level);
+
+    const DFG *dfg_;
+    unsigned budget_;
+    std::vector<Permutation> generators_;
+    // the node of each color in the first discrete coloring
+    std::vector<int> first_leaf_;
+    // the cell sizes of the colorings on the first path
+    std::vector<std::vector<int>> first_sizes_;
+};
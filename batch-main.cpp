@@ -0,0 +1,371 @@
+/* Copyright (C) 2013-2026 Emanuele Giaquinta
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation; either version 2, or (at your option) any
+   later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#include "common.h"
+#include "dfg.h"
+#include "mvs.h"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <dirent.h>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Job {
+    std::string path;
+    std::unique_ptr<DFG> dfg;
+    double cost = 0;
+    std::string error;
+};
+
+// bounded queue of parsed graphs, the graph with the largest expected
+// cost is dequeued first
+class JobQueue {
+public:
+    JobQueue(unsigned capacity)
+        : capacity_(capacity)
+    {
+    }
+
+    void push(Job &&job)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return jobs_.size() < capacity_; });
+        jobs_.push_back(std::move(job));
+        std::push_heap(jobs_.begin(), jobs_.end(), cmp);
+        not_empty_.notify_one();
+    }
+
+    bool pop(Job &job)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return !jobs_.empty() || closed_; });
+        if (jobs_.empty())
+            return false;
+        std::pop_heap(jobs_.begin(), jobs_.end(), cmp);
+        job = std::move(jobs_.back());
+        jobs_.pop_back();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    static bool cmp(const Job &j1, const Job &j2) { return j1.cost < j2.cost; }
+
+    std::vector<Job> jobs_;
+    unsigned capacity_;
+    bool closed_ = false;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+};
+
+struct Options {
+    int max_num_in;
+    int max_num_out;
+    MVSFinder::IterType itype = MVSFinder::IterType::LINEAR_REV;
+    uint8_t flags = 0xff;
+    bool use_weights = false;
+};
+
+bool is_directory(const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+off_t file_size(const std::string &path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+        return -1;
+    return st.st_size;
+}
+
+// the regular files in directory 'path', or the files listed one per
+// line in the manifest 'path'. Relative paths in a manifest are
+// relative to the directory of the manifest.
+std::vector<std::string> list_graphs(const std::string &path)
+{
+    std::vector<std::string> paths;
+    if (is_directory(path)) {
+        DIR *dir = opendir(path.c_str());
+        if (!dir)
+            throw std::runtime_error("cannot open " + path);
+        while (struct dirent *entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name[0] == '.')
+                continue;
+            std::string file = path + "/" + name;
+            if (file_size(file) != -1)
+                paths.push_back(file);
+        }
+        closedir(dir);
+        std::sort(paths.begin(), paths.end());
+    } else {
+        std::ifstream manifest(path);
+        if (!manifest)
+            throw std::runtime_error("cannot open " + path);
+        std::string dir;
+        auto pos = path.rfind('/');
+        if (pos != std::string::npos)
+            dir = path.substr(0, pos + 1);
+        std::string line;
+        while (std::getline(manifest, line, '\n')) {
+            if (line.empty() || line[0] == '#')
+                continue;
+            paths.push_back(line[0] == '/' ? line : dir + line);
+        }
+    }
+    return paths;
+}
+
+// the number of nodes that can belong to a subgraph; the cost of the
+// search grows with it
+double expected_cost(const DFG &dfg)
+{
+    return dfg.num_nodes() - dfg.forbidden().size();
+}
+
+void read_graphs(const std::vector<std::string> &paths,
+                 bool use_weights,
+                 JobQueue &queue)
+{
+    for (auto &path : paths) {
+        Job job;
+        job.path = path;
+        try {
+            std::ifstream input(path);
+            if (!input)
+                throw std::runtime_error("cannot open file");
+            job.dfg = DFG::make_dfg(input, use_weights);
+            job.cost = expected_cost(*job.dfg);
+        } catch (const std::exception &e) {
+            job.error = e.what();
+        }
+        queue.push(std::move(job));
+    }
+    queue.close();
+}
+
+nlohmann::json solve(const Job &job, const Options &opts)
+{
+    if (!job.dfg)
+        return {
+            {"error", job.error},
+            {"file", job.path},
+        };
+
+    try {
+        const DFG &dfg = *job.dfg;
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<IOSubgraph> output;
+        if (dfg.forbidden().size() != dfg.num_nodes()) {
+            MVSFinder finder(dfg, nullptr);
+            output = finder.enumerate(
+                opts.max_num_in, opts.max_num_out, opts.itype, opts.flags);
+        }
+        const auto end = std::chrono::steady_clock::now();
+        const std::chrono::duration<double> elapsed = end - start;
+
+        double max_weight = !output.empty() ? output[0].weight() : 0;
+        return {
+            {"file", job.path},
+            {"frequency", dfg.frequency()},
+            {"max_weight", max_weight},
+            {"name", dfg.name()},
+            {"num_nodes", dfg.num_nodes()},
+            {"num_subgraphs", output.size()},
+            {"score", dfg.frequency() * max_weight},
+            {"subgraphs", output},
+            {"time", elapsed.count()},
+        };
+    } catch (const std::exception &e) {
+        return {
+            {"error", e.what()},
+            {"file", job.path},
+        };
+    }
+}
+
+void solve_graphs(JobQueue &queue,
+                  const Options &opts,
+                  std::vector<nlohmann::json> &results,
+                  std::mutex &mutex)
+{
+    Job job;
+    while (queue.pop(job)) {
+        auto result = solve(job, opts);
+        job.dfg.reset();
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(std::move(result));
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    Options opts;
+    unsigned num_workers = std::max(std::thread::hardware_concurrency(), 1u);
+    unsigned queue_size = 0;
+
+    int c;
+    while ((c = getopt(argc, argv, "i:j:o:q:w")) != -1) {
+        int v;
+        switch (c) {
+            case 'i':
+                if (!parse_itype(std::string(optarg), opts.itype)) {
+                    fprintf(stderr, "invalid iteration type\n");
+                    return 1;
+                }
+                break;
+            case 'j':
+                if (!parse_integer(std::string(optarg), v, 1, INT_MAX)) {
+                    fprintf(stderr, "invalid number of workers\n");
+                    return 1;
+                }
+                num_workers = v;
+                break;
+            case 'o':
+                if (!parse_flags(std::string(optarg), opts.flags)) {
+                    fprintf(stderr, "invalid optimization list\n");
+                    return 1;
+                }
+                break;
+            case 'q':
+                if (!parse_integer(std::string(optarg), v, 1, INT_MAX)) {
+                    fprintf(stderr, "invalid queue size\n");
+                    return 1;
+                }
+                queue_size = v;
+                break;
+            case 'w':
+                opts.use_weights = true;
+                break;
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
+
+    if (argc < 4) {
+        fprintf(stdout,
+                "Usage: mvs-batch [OPTIONS] MAX-IN MAX-OUT DIR|MANIFEST\n"
+                "  -j N\t\t\tuse N worker threads\n"
+                "  -q N\t\t\tparse at most N graphs ahead of the "
+                "workers\n"
+                "  -o ARG\t\tdisable optimizations, see mvs\n"
+                "  -i ARG\t\tset iteration type, see mvs\n"
+                "  -w\t\t\tuse real weights\n");
+        return 1;
+    }
+
+    if (!parse_integer(std::string(argv[1]), opts.max_num_in, 0, INT_MAX)) {
+        fprintf(stderr, "invalid input threshold\n");
+        return 1;
+    }
+    if (!parse_integer(std::string(argv[2]), opts.max_num_out, 0, INT_MAX)) {
+        fprintf(stderr, "invalid output threshold\n");
+        return 1;
+    }
+
+    std::vector<std::string> paths;
+    try {
+        paths = list_graphs(std::string(argv[3]));
+    } catch (const std::exception &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    // start with the largest files, the queue refines the order among
+    // the graphs parsed ahead of the workers
+    std::vector<std::pair<off_t, std::string>> files;
+    for (auto &path : paths)
+        files.emplace_back(file_size(path), path);
+    std::stable_sort(files.begin(),
+                     files.end(),
+                     [](const std::pair<off_t, std::string> &f1,
+                        const std::pair<off_t, std::string> &f2) {
+                         return f1.first > f2.first;
+                     });
+    for (unsigned i = 0; i < files.size(); i++)
+        paths[i] = files[i].second;
+
+    if (queue_size == 0)
+        queue_size = 4 * num_workers;
+
+    const auto start = std::chrono::steady_clock::now();
+    JobQueue queue(queue_size);
+    std::vector<nlohmann::json> results;
+    std::mutex mutex;
+    std::thread reader(
+        read_graphs, std::cref(paths), opts.use_weights, std::ref(queue));
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < num_workers; i++)
+        workers.emplace_back(solve_graphs,
+                             std::ref(queue),
+                             std::cref(opts),
+                             std::ref(results),
+                             std::ref(mutex));
+    reader.join();
+    for (auto &worker : workers)
+        worker.join();
+    const auto end = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> elapsed = end - start;
+
+    // rank the graphs by frequency times weight of their maximum
+    // subgraphs, graphs that could not be read come last
+    std::sort(results.begin(),
+              results.end(),
+              [](const nlohmann::json &r1, const nlohmann::json &r2) {
+                  double s1 = r1.value("score", -1.0);
+                  double s2 = r2.value("score", -1.0);
+                  if (s1 != s2)
+                      return s1 > s2;
+                  return r1["file"] < r2["file"];
+              });
+
+    nlohmann::json report = {
+        {"graphs", results},
+        {"num_graphs", results.size()},
+        {"time", elapsed.count()},
+    };
+    std::cout << report.dump(4) << std::endl;
+
+    return 0;
+}
@@ -15,54 +15,217 @@
 
 #include "cluster.h"
 #include "dfg.h"
-#include "vs.h"
+#include "intset.h"
+#include <queue>
 #include <utility>
 #include <vector>
 
-std::vector<SCluster> scluster_enumerate(const DFG &dfg)
+// immediate dominators of a DAG, given the nodes in topological order
+// and the predecessors of each node, with the single-pass algorithm of
+// Cooper, Harvey and Kennedy. The root n is the immediate dominator of
+// the nodes without predecessors.
+class DominatorTree {
+public:
+    template <typename Pred>
+    DominatorTree(const std::vector<int> &order, Pred &&pred);
+
+    int parent(int u) const { return parent_[u]; }
+    int depth(int u) const { return depth_[u]; }
+    bool dominates(int u, int v) const
+    {
+        return pre_[u] <= pre_[v] && post_[v] <= post_[u];
+    }
+    int lca(int u, int v) const;
+
+private:
+    std::vector<int> parent_;
+    std::vector<int> depth_;
+    // preorder and postorder numbers of the nodes in the tree
+    std::vector<int> pre_;
+    std::vector<int> post_;
+};
+
+template <typename Pred>
+DominatorTree::DominatorTree(const std::vector<int> &order, Pred &&pred)
 {
-    std::vector<SCluster> output;
-    std::vector<IOSubgraph> subgraphs;
-    vs_enumerate(dfg, 1, 1, [&subgraphs](const IOSubgraph &subgraph) {
-        if (subgraph.nodes().size() == 1)
-            return;
-        for (auto it = subgraphs.begin(); it != subgraphs.end();) {
-            if (subgraph.nodes().is_subset_of((*it).nodes()))
-                return;
-            if ((*it).nodes().is_subset_of(subgraph.nodes()))
-                it = subgraphs.erase(it);
+    int n = order.size();
+    parent_.assign(n + 1, n);
+    depth_.assign(n + 1, 0);
+    for (auto u : order) {
+        int d = -1;
+        for (auto &v : pred(u))
+            d = d == -1 ? v : lca(d, v);
+        parent_[u] = d == -1 ? n : d;
+        depth_[u] = depth_[parent_[u]] + 1;
+    }
+
+    std::vector<std::vector<int>> children(n + 1);
+    for (auto u : order)
+        children[parent_[u]].push_back(u);
+    pre_.resize(n + 1);
+    post_.resize(n + 1);
+    int num_pre = 0;
+    int num_post = 0;
+    std::vector<std::pair<int, unsigned>> stack {{n, 0}};
+    pre_[n] = num_pre++;
+    while (!stack.empty()) {
+        auto &top = stack.back();
+        if (top.second == children[top.first].size()) {
+            post_[top.first] = num_post++;
+            stack.pop_back();
+            continue;
+        }
+        int v = children[top.first][top.second++];
+        pre_[v] = num_pre++;
+        stack.emplace_back(v, 0);
+    }
+}
+
+int DominatorTree::lca(int u, int v) const
+{
+    while (u != v) {
+        if (depth_[u] < depth_[v])
+            std::swap(u, v);
+        u = parent_[u];
+    }
+    return u;
+}
+
+static SCluster make_scluster(const DFG &dfg, const intset &subgraph)
+{
+    std::vector<std::pair<int, double>> nodes;
+    std::vector<std::pair<int, int>> edges;
+    int vi = -1;
+    int vo = -1;
+    for (const auto &u : subgraph) {
+        for (auto &v : dfg.out_edges(u)) {
+            if (subgraph.contains(v))
+                edges.emplace_back(u, v);
             else
-                it++;
+                vo = u;
         }
-        subgraphs.emplace_back(subgraph);
-    });
 
-    for (const auto &subgraph : subgraphs) {
-        std::vector<std::pair<int, double>> nodes;
-        std::vector<std::pair<int, int>> edges;
-        int vi = -1;
-        int vo = -1;
-        for (const auto &u : subgraph.nodes()) {
-            for (auto &v : dfg.out_edges(u)) {
-                if (subgraph.nodes().contains(v))
-                    edges.emplace_back(u, v);
-                else
-                    vo = u;
+        if (u != vo)
+            nodes.emplace_back(u, dfg.weight(u));
+
+        for (auto &v : dfg.in_edges(u)) {
+            if (v >= dfg.num_nodes() || !subgraph.contains(v)) {
+                edges.emplace_back(v, u);
+                vi = v;
             }
+        }
+    }
+    return SCluster(std::move(nodes), std::move(edges), vi, vo);
+}
 
-            if (u != vo)
-                nodes.emplace_back(u, dfg.weight(u));
+// An S-cluster is a maximal subgraph with one input i and one output o.
+// Its nodes are dominated by i and post-dominated by o, and the
+// subgraph with input i and output o, if any, is the connected
+// component of o in the nodes strictly dominated by i and
+// post-dominated by o, provided that no edge enters it from a node
+// other than i and no edge leaves it from a node other than o. For
+// each output, the input climbs the dominators of o, the component
+// grows with it, and the last input without such an edge gives the
+// largest subgraph. An edge that enters the component from a node not
+// post-dominated by o, or a forbidden node in the component, rules out
+// the dominators above as well. The outputs are visited in reverse
+// topological order, so that an S-cluster is found before the outputs
+// it contains, which are skipped.
+std::vector<SCluster> scluster_enumerate(const DFG &dfg)
+{
+    int n = dfg.num_nodes();
+    std::vector<int> order;
+    order.reserve(n);
+    DFSVisitor visitor(dfg, [&order](int u) { order.push_back(u); });
+    std::vector<int> topo_order(order.rbegin(), order.rend());
+    DominatorTree dom(topo_order, [&dfg](int u) -> const vset<int> & {
+        return dfg.in_edges(u);
+    });
+    DominatorTree pdom(order, [&dfg](int u) -> const vset<int> & {
+        return dfg.out_edges(u);
+    });
 
-            for (auto &v : dfg.in_edges(u)) {
-                if (v >= dfg.num_nodes() || !subgraph.nodes().contains(v)) {
-                    edges.emplace_back(v, u);
-                    vi = v;
+    auto &forbidden = dfg.forbidden();
+    intset clustered(n);
+    std::vector<intset> subgraphs;
+    // mark[u] is o if u is in the component of output o
+    std::vector<int> mark(n, -1);
+    std::vector<int> component;
+    // successors of the component not dominated by the input, by the
+    // depth of their nearest common dominator with it
+    std::priority_queue<std::pair<int, int>> pending;
+    for (auto o : order) {
+        if (forbidden.contains(o) || clustered.contains(o))
+            continue;
+
+        int i = dom.parent(o);
+        unsigned size = 0;
+        component.assign(1, o);
+        mark[o] = o;
+        pending = {};
+        for (unsigned k = 0; i != n;) {
+            bool stop = false;
+            for (; k < component.size() && !stop; k++) {
+                int u = component[k];
+                stop = forbidden.contains(u);
+                for (auto &w : dfg.in_edges(u)) {
+                    if (w == i || mark[w] == o)
+                        continue;
+                    if (!pdom.dominates(o, w)) {
+                        stop = true;
+                        break;
+                    }
+                    mark[w] = o;
+                    component.push_back(w);
+                }
+                if (u == o)
+                    continue;
+                for (auto &v : dfg.out_edges(u)) {
+                    if (mark[v] == o)
+                        continue;
+                    if (!dom.dominates(i, v)) {
+                        pending.emplace(dom.depth(dom.lca(i, v)), v);
+                        continue;
+                    }
+                    mark[v] = o;
+                    component.push_back(v);
+                }
+            }
+            if (stop)
+                break;
+            while (!pending.empty() && mark[pending.top().second] == o)
+                pending.pop();
+            if (pending.empty())
+                size = component.size();
+
+            // the input joins the component
+            if (!pdom.dominates(o, i))
+                break;
+            mark[i] = o;
+            component.push_back(i);
+            i = dom.parent(i);
+            while (!pending.empty() && pending.top().first >= dom.depth(i)) {
+                int v = pending.top().second;
+                pending.pop();
+                if (mark[v] != o) {
+                    mark[v] = o;
+                    component.push_back(v);
                 }
             }
         }
 
-        output.emplace_back(std::move(nodes), std::move(edges), vi, vo);
+        if (size < 2)
+            continue;
+        subgraphs.emplace_back(n);
+        for (unsigned k = 0; k < size; k++) {
+            subgraphs.back().add(component[k]);
+            clustered.add(component[k]);
+        }
     }
+
+    std::vector<SCluster> output;
+    for (auto it = subgraphs.rbegin(); it != subgraphs.rend(); it++)
+        output.push_back(make_scluster(dfg, *it));
     return output;
 }
 
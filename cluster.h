@@ -30,6 +30,13 @@ public:
                 config.remove(node.first);
     }
 
+    // take the weights of the nodes from dfg
+    void reweight(const DFG &dfg)
+    {
+        for (auto &node : nodes_)
+            node.second = dfg.weight(node.first);
+    }
+
     int src() const { return src_; }
     int dst() const { return dst_; }
     const std::vector<std::pair<int, double>> &nodes() const { return nodes_; }
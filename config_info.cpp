@@ -31,7 +31,7 @@ int main(int argc, char *argv[])
 
     std::unique_ptr<DFG> dfg = DFG::make_dfg(std::cin, false);
 
-    IOSubgraph config(*dfg);
+    TrackedSubgraph config(*dfg);
     for (auto &field : split(std::string(argv[1]), ' ')) {
         int v;
         if (!parse_integer(field, v, 0, dfg->num_nodes() - 1)) {
@@ -42,7 +42,7 @@ int main(int argc, char *argv[])
     }
 
     intset closure = config.closure();
-    nlohmann::json json = config;
+    nlohmann::json json = config.subgraph();
     json["convex"] = config.nodes() == closure;
     json["valid"] = !config.nodes().intersects(dfg->forbidden());
     std::cout << json.dump(4) << std::endl;
@@ -0,0 +1,46 @@
+/* Copyright (C) 2013-2026 Emanuele Giaquinta
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation; either version 2, or (at your option) any
+   later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#include "nlohmann/json.hpp"
+#include "result.h"
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char *argv[])
+{
+    if (argc > 2) {
+        fprintf(stdout, "Usage: mvs-convert [FILE]\n");
+        return 1;
+    }
+
+    std::ifstream file;
+    if (argc == 2) {
+        file.open(argv[1], std::ios::binary);
+        if (!file) {
+            fprintf(stderr, "cannot open %s\n", argv[1]);
+            return 1;
+        }
+    }
+    try {
+        auto report = read_result(argc == 2 ? file : std::cin);
+        std::cout << report.dump(4) << std::endl;
+    } catch (const std::exception &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -15,20 +15,23 @@
 
 #include "dfg.h"
 #include "common.h"
+#include "intset_stats.h"
 #include "vset.h"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <climits>
 #include <cstdlib>
 #include <functional>
 #include <initializer_list>
 #include <istream>
-#include <list>
 #include <memory>
 #include <stack>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
 DFG::DFG(std::initializer_list<std::pair<int, int>> list)
 {
@@ -39,8 +42,7 @@ DFG::DFG(std::initializer_list<std::pair<int, int>> list)
             edge.first + 1,
             edge.second + 1,
         });
-    for (int i = 0; i < num_nodes; i++)
-        nodes_.emplace_back(num_nodes);
+    nodes_.resize(num_nodes);
     for (auto &edge : list)
         add_edge(edge.first, edge.second);
 }
@@ -87,6 +89,8 @@ std::unique_ptr<DFG> DFG::make_dfg(std::istream &in, bool set_weights)
                 dfg->weight(id - 1) = strtod(fields[2].c_str(), nullptr);
         }
     }
+    if (!dfg)
+        throw std::runtime_error("missing problem line");
     double max_weight = 0;
     for (int i = 0; i < dfg->num_nodes(); i++)
         max_weight += dfg->weight(i);
@@ -95,76 +99,232 @@ std::unique_ptr<DFG> DFG::make_dfg(std::istream &in, bool set_weights)
     return dfg;
 }
 
-void DFG::index()
+// swap the bits of a[k] in the positions with bit j set with the bits
+// of a[k + j] in the positions with bit j clear, for every k with bit j
+// clear
+template <unsigned j>
+static void transpose_step(intset::block a[64], intset::block m)
 {
-    // compute a topological ordering, just in case
-    std::list<int> topo_order;
-    DFSVisitor visitor(*this, [this, &topo_order](int u) {
-        nodes_[u].pred.clear();
-        nodes_[u].succ.clear();
-        topo_order.push_front(u);
-    });
+    for (unsigned k = 0; k < 64; k += 2 * j)
+        for (unsigned l = k; l < k + j; l++) {
+            intset::block t = ((a[l] >> j) ^ a[l + j]) & m;
+            a[l + j] ^= t;
+            a[l] ^= t << j;
+        }
+}
 
-    // compute pred and succ sets for each node
-    for (auto &u : topo_order) {
-        // if (F_.contains(u))
-        //   continue;
+// transpose a matrix of 64x64 bits, where bit c of a[r] is the element
+// in row r and column c
+static void transpose(intset::block a[64])
+{
+    static_assert(intset::bits_per_block == 64, "");
+    transpose_step<32>(a, 0x00000000ffffffff);
+    transpose_step<16>(a, 0x0000ffff0000ffff);
+    transpose_step<8>(a, 0x00ff00ff00ff00ff);
+    transpose_step<4>(a, 0x0f0f0f0f0f0f0f0f);
+    transpose_step<2>(a, 0x3333333333333333);
+    transpose_step<1>(a, 0x5555555555555555);
+}
 
-        for (auto &v : out_edges(u)) {
-            nodes_[v].pred.add(nodes_[u].pred);
-            nodes_[v].pred.add(u);
-        }
-    }
+// run f(0), ..., f(num_tasks - 1) on num_threads threads
+template <typename F>
+static void parallel_for(unsigned num_tasks, unsigned num_threads, F &&f)
+{
+    std::atomic<unsigned> next(0);
+    auto worker = [&]() {
+        for (unsigned i; (i = next++) < num_tasks;)
+            f(i);
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < std::min(num_threads, num_tasks); i++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &thread : threads)
+        thread.join();
+}
 
-    for (auto it = topo_order.rbegin(); it != topo_order.rend(); it++) {
-        auto u = *it;
-        // if (F_.contains(u))
-        //   continue;
+// add to the set of each node in [first, last) its neighbors and their
+// sets, where the neighbors of a node come before it. The blocks of the
+// sets are split in tiles of 'tile' blocks, which are independent.
+template <typename It, typename Edges>
+static void propagate(std::vector<intset> &sets,
+                      It first,
+                      It last,
+                      Edges &&edges,
+                      unsigned tile,
+                      unsigned num_threads)
+{
+    unsigned num_blocks = sets.empty() ? 0 : sets[0].num_blocks();
+    unsigned num_tiles = (num_blocks + tile - 1) / tile;
+    parallel_for(num_tiles, num_threads, [&](unsigned t) {
+        unsigned begin = t * tile;
+        unsigned end = std::min(begin + tile, num_blocks);
+        for (auto it = first; it != last; ++it) {
+            auto row = sets[*it].data();
+            for (auto &v : edges(*it)) {
+                auto src = sets[v].data();
+                for (unsigned i = begin; i < end; i++)
+                    row[i] |= src[i];
+                if (v / 64 >= begin && v / 64 < end)
+                    row[v / 64] |= intset::block(1) << (v % 64);
+            }
+        }
+    });
+}
 
-        for (auto &v : out_edges(u)) {
-            nodes_[u].succ.add(nodes_[v].succ);
-            nodes_[u].succ.add(v);
+// u is in pred(v) if v is in succ(u), block j of the pred sets of nodes
+// 64i..64i+63 is the transpose of block i of the succ sets of nodes
+// 64j..64j+63. The blocks are transposed 32 at a time, to read several
+// cache lines of each succ set at once.
+static void transpose_sets(const std::vector<intset> &succ,
+                           std::vector<intset> &pred,
+                           unsigned num_threads)
+{
+    unsigned n = succ.size();
+    unsigned num_blocks = (n + 63) / 64;
+    parallel_for((num_blocks + 31) / 32, num_threads, [&](unsigned t) {
+        unsigned first = t * 32;
+        unsigned last = std::min(first + 32, num_blocks);
+        intset::block a[32][64];
+        for (unsigned j = 0; j < num_blocks; j++) {
+            intset::block any[32] = {};
+            for (unsigned k = 0; k < 64; k++) {
+                if (64 * j + k >= n) {
+                    for (unsigned i = first; i < last; i++)
+                        a[i - first][k] = 0;
+                    continue;
+                }
+                auto src = succ[64 * j + k].data();
+                for (unsigned i = first; i < last; i++) {
+                    a[i - first][k] = src[i];
+                    any[i - first] |= src[i];
+                }
+            }
+            // the pred sets are empty to begin with
+            for (unsigned i = first; i < last; i++) {
+                if (!any[i - first])
+                    continue;
+                transpose(a[i - first]);
+                for (unsigned k = 0; k < 64 && 64 * i + k < n; k++)
+                    pred[64 * i + k].data()[j] = a[i - first][k];
+            }
         }
+    });
+}
+
+void DFG::index()
+{
+    INTSET_PHASE("index");
+    int n = num_nodes();
+
+    // sort the nodes by level, where the level of a node is the length
+    // of the longest path to a sink. The successors of a node are in
+    // lower levels, and the nodes of a level are independent.
+    std::vector<int> order;
+    order.reserve(n);
+    DFSVisitor visitor(*this, [&order](int u) { order.push_back(u); });
+    std::vector<int> level(n);
+    std::vector<int> level_start(n + 1);
+    for (auto u : order) {
+        for (auto &v : out_edges(u))
+            level[u] = std::max(level[u], level[v] + 1);
+        level_start[level[u] + 1]++;
     }
+    for (int l = 0; l < n; l++)
+        level_start[l + 1] += level_start[l];
+    std::vector<int> sorted(n);
+    for (auto u : order)
+        sorted[level_start[level[u]]++] = u;
+
+    // the succ sets are computed level by level. With several threads,
+    // each one computes tiles of columns of 256 KB that fit in the
+    // cache. A single thread computes whole rows, which is faster.
+    auto index = std::make_shared<Index>(n);
+    unsigned num_blocks = (n + 63) / 64;
+    unsigned num_threads = n >= 2048 ? std::thread::hardware_concurrency() : 1;
+    unsigned tile = num_blocks;
+    if (num_threads > 1)
+        tile = std::max<size_t>(
+            8, (256 << 10) / (size_t(n) * sizeof(intset::block)));
+    propagate(index->succ,
+              sorted.begin(),
+              sorted.end(),
+              [this](int u) -> const vset<int> & { return out_edges(u); },
+              tile,
+              num_threads);
+
+    // the pred sets are computed in the same way on sparse graphs, such
+    // as data flow graphs. On denser graphs, transposing the succ sets
+    // is faster.
+    size_t num_edges = 0;
+    for (int u = 0; u < n; u++)
+        num_edges += out_edges(u).size();
+    if (num_edges <= 6 * size_t(n))
+        propagate(index->pred,
+                  sorted.rbegin(),
+                  sorted.rend(),
+                  [this](int u) -> const vset<int> & { return in_edges(u); },
+                  tile,
+                  num_threads);
+    else
+        transpose_sets(index->succ, index->pred, num_threads);
+
+    for (int u = 0; u < n; u++)
+        if (is_forbidden(u) || in_edges(u).empty() || out_edges(u).empty())
+            index->forbidden.add(u);
+    index_ = std::move(index);
 }
 
-intset DFG::forbidden() const
+void DFG::read_weights(std::istream &in)
 {
-    intset s(num_nodes());
+    std::string line;
+    std::vector<double> weights(num_nodes());
+    std::vector<bool> found(num_nodes());
+    while (std::getline(in, line, '\n')) {
+        auto fields = split(line, ' ');
+        if (fields[0] != "n")
+            continue;
+        int id;
+        if (fields.size() < 3 || !parse_integer(fields[1], id, 1, num_nodes()))
+            throw std::runtime_error("invalid line");
+        weights[id - 1] = strtod(fields[2].c_str(), nullptr);
+        found[id - 1] = true;
+    }
+    double max_weight = 0;
     for (int i = 0; i < num_nodes(); i++) {
-        if (is_forbidden(i) || in_edges(i).empty() || out_edges(i).empty())
-            s.add(i);
+        if (!found[i])
+            throw std::runtime_error("missing node line");
+        max_weight += weights[i];
     }
-    return s;
+    if (max_weight > INT_MAX)
+        throw std::runtime_error("total weight too large");
+    for (int i = 0; i < num_nodes(); i++)
+        weight(i) = weights[i];
 }
 
-void DFSVisitor::i_visit(const DFG &dfg,
-                         int u,
-                         const std::function<void(int)> &visit_cb)
+void DFG::apply(const DFGDelta &delta)
 {
-    struct Frame {
-        int node;
-        vset<int>::const_iterator it;
-    };
-    std::stack<Frame> stack;
-    stack.push({u, dfg.out_edges(u).begin()});
-    visited_[u] = true;
-    while (!stack.empty()) {
-        auto frame = stack.top();
-        stack.pop();
-        int u = frame.node;
-        auto it = frame.it;
-        while (it != dfg.out_edges(u).end()) {
-            int v = *it++;
-            if (!visited_[v]) {
-                visited_[v] = true;
-                stack.push({u, it});
-                u = v;
-                it = dfg.out_edges(u).begin();
-            }
-        }
-        visit_cb(u);
-    }
+    for (auto u : delta.forbidden)
+        set_forbidden(u);
+    for (auto &edge : delta.added_edges)
+        add_edge(edge.first, edge.second);
+    for (auto &edge : delta.removed_edges)
+        remove_edge(edge.first, edge.second);
+    index();
+}
+
+size_t DFG::memory_size() const
+{
+    size_t size = sizeof(*this) + name_.capacity();
+    for (auto &node : nodes_)
+        size += sizeof(node) +
+                (node.in_list.capacity() + node.out_list.capacity()) *
+                    sizeof(int);
+    if (index_)
+        size += (2 * num_nodes() + 1) *
+                (sizeof(intset) +
+                 (num_nodes() + 63) / 64 * sizeof(unsigned long));
+    return size;
 }
 
 intset Subgraph::pred() const
@@ -190,6 +350,113 @@ intset Subgraph::closure() const
     return nodes_ | pred() & succ();
 }
 
+TrackedSubgraph::Counter::Counter(int num_nodes)
+    : num_blocks((num_nodes + 63) / 64)
+{
+    // a count is at most num_nodes
+    unsigned n = 1;
+    while (num_nodes >> n)
+        n++;
+    planes.resize(n * num_blocks);
+}
+
+// add 1 to the count of the nodes in s, with the carry of each block
+// rippling through the planes, and add the nodes not in 'nodes' to 'out'
+void TrackedSubgraph::Counter::add(const intset &s,
+                                   const intset &nodes,
+                                   intset &out)
+{
+    auto data = s.data();
+    for (unsigned i = 0; i < num_blocks; i++) {
+        intset::block carry = data[i];
+        if (!carry)
+            continue;
+        out.data()[i] |= carry & ~nodes.data()[i];
+        unsigned p = 0;
+        for (; carry; p++) {
+            auto &plane = planes[p * num_blocks + i];
+            intset::block t = plane & carry;
+            plane ^= carry;
+            carry = t;
+        }
+        num_planes = std::max(num_planes, p);
+    }
+}
+
+// subtract 1 from the count of the nodes in s, and remove the nodes
+// whose count drops to 0 from 'out'
+void TrackedSubgraph::Counter::subtract(const intset &s,
+                                        const intset &nodes,
+                                        intset &out)
+{
+    auto data = s.data();
+    for (unsigned i = 0; i < num_blocks; i++) {
+        intset::block borrow = data[i];
+        if (!borrow)
+            continue;
+        for (unsigned p = 0; borrow; p++) {
+            auto &plane = planes[p * num_blocks + i];
+            intset::block t = ~plane & borrow;
+            plane ^= borrow;
+            borrow = t;
+        }
+        intset::block any = 0;
+        for (unsigned p = 0; p < num_planes; p++)
+            any |= planes[p * num_blocks + i];
+        out.data()[i] = any & ~nodes.data()[i];
+    }
+}
+
+bool TrackedSubgraph::Counter::nonzero(int u) const
+{
+    for (unsigned p = 0; p < num_planes; p++)
+        if (planes[p * num_blocks + u / 64] & (intset::block(1) << (u % 64)))
+            return true;
+    return false;
+}
+
+TrackedSubgraph::TrackedSubgraph(const DFG &dfg)
+    : subgraph_(dfg)
+    , pred_count_(dfg.num_nodes())
+    , succ_count_(dfg.num_nodes())
+    , pred_(dfg.num_nodes())
+    , succ_(dfg.num_nodes())
+{
+}
+
+TrackedSubgraph::TrackedSubgraph(const DFG &dfg, const intset &&nodes)
+    : subgraph_(dfg, std::move(nodes))
+    , pred_count_(dfg.num_nodes())
+    , succ_count_(dfg.num_nodes())
+    , pred_(dfg.num_nodes())
+    , succ_(dfg.num_nodes())
+{
+    for (auto u : subgraph_.nodes()) {
+        pred_count_.add(dfg.pred(u), subgraph_.nodes(), pred_);
+        succ_count_.add(dfg.succ(u), subgraph_.nodes(), succ_);
+    }
+}
+
+void TrackedSubgraph::add(int u)
+{
+    subgraph_.add(u);
+    pred_.remove(u);
+    succ_.remove(u);
+    pred_count_.add(dfg().pred(u), subgraph_.nodes(), pred_);
+    succ_count_.add(dfg().succ(u), subgraph_.nodes(), succ_);
+}
+
+void TrackedSubgraph::remove(int u)
+{
+    subgraph_.remove(u);
+    pred_count_.subtract(dfg().pred(u), subgraph_.nodes(), pred_);
+    succ_count_.subtract(dfg().succ(u), subgraph_.nodes(), succ_);
+    if (pred_count_.nonzero(u))
+        pred_.add(u);
+    if (succ_count_.nonzero(u))
+        succ_.add(u);
+}
+
 void IOSubgraph::init_weight()
 {
     weight_ = 0;
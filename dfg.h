@@ -2,37 +2,62 @@
 
 #include "intset.h"
 #include "vset.h"
+#include <cassert>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <stack>
 #include <string>
+#include <utility>
+#include <vector>
+
+// a local change of a graph: nodes to mark as forbidden and edges to
+// add or remove
+struct DFGDelta {
+    std::vector<int> forbidden;
+    std::vector<std::pair<int, int>> added_edges;
+    std::vector<std::pair<int, int>> removed_edges;
+};
 
 class DFG {
     struct Node {
-        Node(int num_nodes)
-            : pred(num_nodes)
-            , succ(num_nodes)
-        {
-        }
-
         vset<int> in_list;
         vset<int> out_list;
         double weight = 1;
         bool forbidden = false;
-        intset pred;
-        intset succ;
+    };
+
+    // pred and succ sets of each node, and forbidden nodes. The index
+    // is immutable once built and is shared by copies of the graph, so
+    // that a copy can change edges and weights without duplicating it.
+    struct Index {
+        Index(int num_nodes)
+            : forbidden(num_nodes)
+        {
+            for (int i = 0; i < num_nodes; i++) {
+                pred.emplace_back(num_nodes);
+                succ.emplace_back(num_nodes);
+            }
+        }
+
+        std::vector<intset> pred;
+        std::vector<intset> succ;
+        intset forbidden;
     };
 
 public:
     DFG(std::string name, int num_nodes, int frequency)
         : name_(std::move(name))
         , frequency_(frequency)
+        , nodes_(num_nodes)
     {
-        for (int i = 0; i < num_nodes; i++)
-            nodes_.emplace_back(num_nodes);
     }
     DFG(std::initializer_list<std::pair<int, int>> list);
     static std::unique_ptr<DFG> make_dfg(std::istream &in, bool set_weights);
+    // set the weights of the nodes in the node lines of a graph in the
+    // input format, the other lines are ignored. Every node must have a
+    // node line, otherwise the weights are left unchanged.
+    void read_weights(std::istream &in);
 
     void add_edge(int u, int v)
     {
@@ -44,30 +69,60 @@ public:
         nodes_[u].out_list.remove(v);
         nodes_[v].in_list.remove(u);
     }
-    void set_forbidden(int u) { nodes_[u].forbidden = true; }
+    // the index is dropped, it must be rebuilt with index(). The edges
+    // can change without rebuilding it, as in the contracted view of
+    // MVSFinder.
+    void set_forbidden(int u)
+    {
+        nodes_[u].forbidden = true;
+        index_.reset();
+    }
     void index();
+    // change the graph by delta and rebuild the index
+    void apply(const DFGDelta &delta);
 
     const std::string &name() const { return name_; }
+    int frequency() const { return frequency_; }
     int num_nodes() const { return nodes_.size(); }
     double weight(int u) const { return nodes_[u].weight; }
     double &weight(int u) { return nodes_[u].weight; }
     const vset<int> &in_edges(int u) const { return nodes_[u].in_list; }
     const vset<int> &out_edges(int u) const { return nodes_[u].out_list; }
-    const intset &pred(int u) const { return nodes_[u].pred; }
-    const intset &succ(int u) const { return nodes_[u].succ; }
+    const intset &pred(int u) const
+    {
+        assert(index_);
+        return index_->pred[u];
+    }
+    const intset &succ(int u) const
+    {
+        assert(index_);
+        return index_->succ[u];
+    }
     bool is_forbidden(int u) const { return nodes_[u].forbidden; }
-    intset forbidden() const;
+    // the nodes marked as forbidden and the sources and sinks, when the
+    // index was built
+    const intset &forbidden() const
+    {
+        assert(index_);
+        return index_->forbidden;
+    }
+    // approximate number of bytes used by the graph and its index
+    size_t memory_size() const;
 
 private:
     std::string name_;
     int frequency_ = 0;
 
     std::vector<Node> nodes_;
+    std::shared_ptr<const Index> index_;
 };
 
+// The visit takes the type of the callback as template parameter, so
+// that the callback can be inlined.
 class DFSVisitor {
 public:
-    DFSVisitor(const DFG &dfg, const std::function<void(int)> &visit_cb)
+    template <typename VisitCb>
+    DFSVisitor(const DFG &dfg, VisitCb &&visit_cb)
         : visited_(std::make_unique<bool[]>(dfg.num_nodes()))
     {
         for (int i = 0; i < dfg.num_nodes(); i++)
@@ -76,9 +131,8 @@ public:
     }
 
 private:
-    void r_visit(const DFG &dfg,
-                 int u,
-                 const std::function<void(int)> &visit_cb)
+    template <typename VisitCb>
+    void r_visit(const DFG &dfg, int u, VisitCb &visit_cb)
     {
         visited_[u] = true;
         for (auto &v : dfg.out_edges(u))
@@ -87,13 +141,40 @@ private:
         visit_cb(u);
     }
 
-    void i_visit(const DFG &dfg,
-                 int u,
-                 const std::function<void(int)> &visit_cb);
+    template <typename VisitCb>
+    void i_visit(const DFG &dfg, int u, VisitCb &visit_cb);
 
     std::unique_ptr<bool[]> visited_;
 };
 
+template <typename VisitCb>
+void DFSVisitor::i_visit(const DFG &dfg, int u, VisitCb &visit_cb)
+{
+    struct Frame {
+        int node;
+        vset<int>::const_iterator it;
+    };
+    std::stack<Frame> stack;
+    stack.push({u, dfg.out_edges(u).begin()});
+    visited_[u] = true;
+    while (!stack.empty()) {
+        auto frame = stack.top();
+        stack.pop();
+        int u = frame.node;
+        auto it = frame.it;
+        while (it != dfg.out_edges(u).end()) {
+            int v = *it++;
+            if (!visited_[v]) {
+                visited_[v] = true;
+                stack.push({u, it});
+                u = v;
+                it = dfg.out_edges(u).begin();
+            }
+        }
+        visit_cb(u);
+    }
+}
+
 class Subgraph {
 public:
     Subgraph(const DFG &dfg)
@@ -171,3 +252,57 @@ private:
     vset<int> outputs_;
     double weight_ = 0;
 };
+
+// a subgraph that keeps its pred and succ sets up to date as nodes are
+// added and removed. For each node of the graph it counts the nodes of
+// the subgraph it is a predecessor or successor of, with the bits of
+// the counts of all nodes stored in one set per bit position, so that a
+// whole pred or succ set is added or subtracted a block at a time. The
+// subgraph is only exposed as a const reference, so that its nodes
+// change only through the add and remove methods of this class.
+class TrackedSubgraph {
+public:
+    TrackedSubgraph(const DFG &dfg);
+    TrackedSubgraph(const DFG &dfg, const intset &&nodes);
+
+    void add(int u);
+    void remove(int u);
+
+    const IOSubgraph &subgraph() const { return subgraph_; }
+    const DFG &dfg() const { return subgraph_.dfg(); }
+    const intset &nodes() const { return subgraph_.nodes(); }
+    const vset<int> &inputs() const { return subgraph_.inputs(); }
+    const vset<int> &outputs() const { return subgraph_.outputs(); }
+    int num_in() const { return subgraph_.num_in(); }
+    int num_out() const { return subgraph_.num_out(); }
+    double weight() const { return subgraph_.weight(); }
+
+    const intset &pred() const { return pred_; }
+    const intset &succ() const { return succ_; }
+    intset closure() const
+    {
+        intset out(subgraph_.nodes());
+        return out.add_intersection(pred_, succ_);
+    }
+
+private:
+    struct Counter {
+        Counter(int num_nodes);
+
+        void add(const intset &s, const intset &nodes, intset &out);
+        void subtract(const intset &s, const intset &nodes, intset &out);
+        bool nonzero(int u) const;
+
+        unsigned num_blocks;
+        // planes that ever had a nonzero bit
+        unsigned num_planes = 0;
+        // bit p of the count of node v is bit v of plane p
+        std::vector<intset::block> planes;
+    };
+
+    IOSubgraph subgraph_;
+    Counter pred_count_;
+    Counter succ_count_;
+    intset pred_;
+    intset succ_;
+};
@@ -25,17 +25,18 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 Graph::Graph(std::initializer_list<std::pair<int, int>> list)
 {
-    int num_nodes = 0;
+    num_nodes_ = 0;
     for (auto &edge : list)
-        num_nodes = std::max({
-            num_nodes,
+        num_nodes_ = std::max({
+            num_nodes_,
             edge.first + 1,
             edge.second + 1,
         });
-    nodes_.resize(num_nodes);
+    nodes_.resize(num_nodes_);
     for (auto &edge : list)
         add_edge(edge.first, edge.second);
 }
@@ -72,139 +73,60 @@ std::unique_ptr<Graph> Graph::make_graph(std::istream &in)
 
 void Graph::invert()
 {
-    for (int i = 0; i < nodes_.size(); i++) {
-        unsigned pos = 0;
-        auto size = nodes_[i].adj_list.size();
-        std::sort(nodes_[i].adj_list.begin(), nodes_[i].adj_list.end());
-        for (int u = 0; u < nodes_.size(); u++) {
-            if (pos < size && nodes_[i].adj_list[pos] == u)
-                pos++;
-            else if (u != i)
-                nodes_[i].adj_list.push_back(u);
-        }
-        nodes_[i].adj_list.erase(nodes_[i].adj_list.begin(),
-                                 nodes_[i].adj_list.begin() + size);
-    }
-}
-
-MISFinderBase::MISFinderBase(const Graph *graph,
-                             std::function<void(const intset &)> output_cb,
-                             std::function<void(const intset &, int, bool)> update_cb)
-    : graph_(graph)
-    , config_(graph->num_nodes())
-    , nodes_left_(graph->num_nodes())
-    , f_nodes_(graph->num_nodes())
-    , output_cb_(std::move(output_cb))
-    , update_cb_(std::move(update_cb))
-{
-    for (int i = 0; i < graph_->num_nodes(); i++)
-        nodes_left_.add(i);
-}
-
-MISFinder::MISFinder(const Graph *graph,
-                     std::function<void(const intset &)> output_cb,
-                     std::function<void(const intset &, int, bool)> update_cb)
-    : MISFinderBase(graph, std::move(output_cb), std::move(update_cb))
-{
-    auto size = graph_->num_nodes();
-    num_edges_.resize(size);
-    g_num_edges_ = 0;
-    for (int i = 0; i < size; i++) {
-        config_.add(i);
-        num_edges_[i] = graph_->edges(i).size();
-        g_num_edges_ += num_edges_[i];
-        update_cb_(config_, i, true);
+    set_dense(true);
+    intset all(num_nodes_);
+    for (int i = 0; i < num_nodes_; i++)
+        all.add(i);
+    long num_edges = 0;
+    for (int i = 0; i < num_nodes_; i++) {
+        intset row = all;
+        rows_[i] = row.remove(rows_[i]).remove(i);
+        num_edges += rows_[i].size();
     }
-    visit();
+    // a row of the matrix takes n bits, an adjacency list 32 bits per
+    // edge
+    set_dense(32 * num_edges >= (long)num_nodes_ * num_nodes_);
 }
 
-void MISFinder::visit()
+void Graph::set_dense(bool dense)
 {
-    calls_++;
-
-    if (g_num_edges_ == 0) {
-        output_cb_(config_);
-        count_++;
+    if (dense == dense_)
         return;
-    }
-
-    bool is_f_node = false;
-    int id = f_nodes_.minimum();
-    if (id != -1) {
-        f_nodes_.remove(id);
-        is_f_node = true;
-    } else {
-        int max_edges = 0;
-        for (const auto &u : nodes_left_) {
-            if (num_edges_[u] > max_edges) {
-                max_edges = num_edges_[u];
-                id = u;
-            }
+    if (dense) {
+        for (int i = 0; i < num_nodes_; i++) {
+            rows_.emplace_back(num_nodes_);
+            for (int v : nodes_[i].adj_list)
+                rows_[i].add(v);
         }
-    }
-    if (id == -1)
-        return;
-
-    nodes_left_.remove(id);
-
-    config_.remove(id);
-    update_cb_(config_, id, false);
-
-    bool prune = false;
-    g_num_edges_ -= 2 * num_edges_[id];
-    for (int v : graph_->edges(id)) {
-        num_edges_[v]--;
-
-        if (num_edges_[v] == 0 && !config_.contains(v))
-            prune = true;
-    }
-    if (!prune)
-        visit();
-    else
-        f_nodes_.clear();
-
-    config_.add(id);
-    update_cb_(config_, id, true);
-
-    g_num_edges_ += 2 * num_edges_[id];
-    if (!is_f_node) {
-        for (int v : graph_->edges(id)) {
-            num_edges_[v]++;
-
-            if (config_.contains(v)) {
-                assert(nodes_left_.contains(v));
-                f_nodes_.add(v);
-            }
-        }
-        visit();
+        nodes_.clear();
     } else {
-        for (int v : graph_->edges(id))
-            num_edges_[v]++;
+        nodes_.resize(num_nodes_);
+        for (int i = 0; i < num_nodes_; i++)
+            for (auto v : rows_[i])
+                nodes_[i].adj_list.push_back(v);
+        rows_.clear();
     }
-
-    nodes_left_.add(id);
+    dense_ = dense;
 }
 
-MISFinderBK::MISFinderBK(const Graph *graph,
-                         std::function<void(const intset &)> output_cb,
-                         std::function<void(const intset &, int, bool)> update_cb)
-    : MISFinderBase(graph, std::move(output_cb), std::move(update_cb))
+MISFinderBase::MISFinderBase(const Graph *graph)
+    : graph_(graph)
+    , config_(graph->num_nodes())
+    , nodes_left_(graph->num_nodes())
+    , f_nodes_(graph->num_nodes())
 {
-    visit();
+    for (int i = 0; i < graph_->num_nodes(); i++)
+        nodes_left_.add(i);
 }
 
-static void find_pivot(const Graph &graph,
-                       const intset &S,
-                       const intset &P,
-                       int &best_id,
-                       int &best_score)
+void MISFinderBase::find_pivot(const Graph &graph,
+                               const intset &S,
+                               const intset &P,
+                               int &best_id,
+                               int &best_score)
 {
     for (const auto &id : S) {
-        int score = 0;
-        for (int v : graph.edges(id)) {
-            if (P.contains(v))
-                score++;
-        }
+        int score = graph.degree(id, P);
         if (best_id == -1 || score < best_score) {
             best_id = id;
             best_score = score;
@@ -212,49 +134,50 @@ static void find_pivot(const Graph &graph,
     }
 }
 
-void MISFinderBK::visit()
+// the node of P or X with the most non-neighbors in P
+int MISFinderBase::find_tomita_pivot(const Graph &graph,
+                                     const intset &P,
+                                     const intset &X)
 {
-    calls_++;
-
-    if (nodes_left_.minimum() == -1 && f_nodes_.minimum() == -1) {
-        output_cb_(config_);
-        count_++;
-        return;
-    }
-
-    intset P(nodes_left_);
-    intset X(f_nodes_);
-
-    int best_score;
     int best_id = -1;
-    find_pivot(*graph_, nodes_left_, nodes_left_, best_id, best_score);
-    find_pivot(*graph_, f_nodes_, nodes_left_, best_id, best_score);
-
-    auto &edges = graph_->edges(best_id);
-    for (int j = 0; j <= edges.size(); j++) {
-        int id = j < edges.size() ? edges[j] : best_id;
-
-        if (!P.contains(id))
-            continue;
-
-        nodes_left_ = P;
-        f_nodes_ = X;
-
-        nodes_left_.remove(id);
-        for (int v : graph_->edges(id)) {
-            nodes_left_.remove(v);
-            f_nodes_.remove(v);
+    int best_score = 0;
+    for (auto S : {&P, &X})
+        for (auto u : *S) {
+            int score = graph.degree(u, P) + P.contains(u);
+            if (best_id == -1 || score < best_score) {
+                best_id = u;
+                best_score = score;
+            }
         }
+    return best_id;
+}
 
-        config_.add(id);
-        update_cb_(config_, id, true);
-
-        visit();
-
-        config_.remove(id);
-        update_cb_(config_, id, false);
-
-        P.remove(id);
-        X.add(id);
+// an order of the nodes of a dense graph where each node has the
+// fewest non-neighbors among the nodes that follow it
+std::vector<int> MISFinderBase::degeneracy_order(const Graph &graph)
+{
+    int n = graph.num_nodes();
+    std::vector<int> degree(n);
+    for (int i = 0; i < n; i++)
+        degree[i] = n - 1 - graph.degree(i);
+    intset left(n);
+    for (int i = 0; i < n; i++)
+        left.add(i);
+    std::vector<int> order;
+    for (int k = 0; k < n; k++) {
+        int u = -1;
+        for (auto v : left)
+            if (u == -1 || degree[v] < degree[u])
+                u = v;
+        order.push_back(u);
+        left.remove(u);
+        intset non_adjacent = left;
+        for (auto v : non_adjacent.remove(graph.row(u)))
+            degree[v]--;
     }
+    return order;
 }
+
+template class BasicMISFinder<>;
+template class BasicMISFinderBK<>;
+template class BasicMISFinderTomita<>;
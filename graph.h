@@ -1,8 +1,10 @@
 #pragma once
 
 #include "intset.h"
+#include "trail.h"
 #include "vset.h"
 #include <algorithm>
+#include <cassert>
 #include <functional>
 #include <iostream>
 #include <memory>
@@ -14,77 +16,551 @@ class Graph {
     };
 
 public:
-    Graph(int num_nodes) { nodes_.resize(num_nodes); }
+    Graph(int num_nodes, bool dense = false)
+        : num_nodes_(num_nodes)
+        , dense_(dense)
+    {
+        if (dense)
+            for (int i = 0; i < num_nodes; i++)
+                rows_.emplace_back(num_nodes);
+        else
+            nodes_.resize(num_nodes);
+    }
     Graph(std::initializer_list<std::pair<int, int>> list);
     static std::unique_ptr<Graph> make_graph(std::istream &in);
 
     void add_edge(int u, int v)
     {
+        if (dense_) {
+            rows_[u].add(v);
+            rows_[v].add(u);
+            return;
+        }
         nodes_[u].adj_list.add(v);
         nodes_[v].adj_list.add(u);
     }
     void remove_edge(int u, int v)
     {
+        if (dense_) {
+            rows_[u].remove(v);
+            rows_[v].remove(u);
+            return;
+        }
         nodes_[u].adj_list.remove(v);
         nodes_[v].adj_list.remove(u);
     }
+    // complement the graph, the representation of the result is chosen
+    // from its density
     void invert();
+    // use adjacency lists or rows of an adjacency matrix
+    void set_dense(bool dense);
+    bool is_dense() const { return dense_; }
 
-    int num_nodes() const { return nodes_.size(); }
+    int num_nodes() const { return num_nodes_; }
     int num_edges() const
     {
         int num_edges = 0;
         for (int i = 0; i < num_nodes(); i++)
-            num_edges += edges(i).size();
+            num_edges += degree(i);
         return num_edges;
     }
-    const vset<int> &edges(int u) const { return nodes_[u].adj_list; }
+    int degree(int u) const
+    {
+        return dense_ ? rows_[u].size() : nodes_[u].adj_list.size();
+    }
+    // number of neighbors of u in s
+    int degree(int u, const intset &s) const
+    {
+        if (dense_)
+            return rows_[u].intersection_size(s);
+        int n = 0;
+        for (int v : nodes_[u].adj_list)
+            if (s.contains(v))
+                n++;
+        return n;
+    }
+    // remove the neighbors of u from s
+    void remove_neighbors(int u, intset &s) const
+    {
+        if (dense_) {
+            s.remove(rows_[u]);
+            return;
+        }
+        for (int v : nodes_[u].adj_list)
+            s.remove(v);
+    }
+    void remove_neighbors(int u, intset &s, Trail &trail) const
+    {
+        if (dense_) {
+            trail.remove(s, rows_[u]);
+            return;
+        }
+        for (int v : nodes_[u].adj_list)
+            trail.remove(s, v);
+    }
+    // neighbors of u in increasing order if the graph is dense or was
+    // inverted, in insertion order otherwise
+    template <typename F>
+    void for_each_edge(int u, F &&f) const
+    {
+        if (dense_) {
+            for (auto v : rows_[u])
+                f(v);
+            return;
+        }
+        for (int v : nodes_[u].adj_list)
+            f(v);
+    }
+    const vset<int> &edges(int u) const
+    {
+        assert(!dense_);
+        return nodes_[u].adj_list;
+    }
+    const intset &row(int u) const
+    {
+        assert(dense_);
+        return rows_[u];
+    }
 
 private:
+    int num_nodes_;
+    bool dense_ = false;
     std::vector<Node> nodes_;
+    std::vector<intset> rows_;
 };
 
 class MISFinderBase {
 public:
-    MISFinderBase(const Graph *graph,
-                  std::function<void(const intset &)> output_cb,
-                  std::function<void(const intset &, int, bool)> update_cb);
     virtual ~MISFinderBase() = default;
 
     unsigned get_count() const { return count_; }
     unsigned get_calls() const { return calls_; }
 
 protected:
+    MISFinderBase(const Graph *graph);
+
+    static void find_pivot(const Graph &graph,
+                           const intset &S,
+                           const intset &P,
+                           int &best_id,
+                           int &best_score);
+    static int find_tomita_pivot(const Graph &graph,
+                                 const intset &P,
+                                 const intset &X);
+    static std::vector<int> degeneracy_order(const Graph &graph);
+
     const Graph *graph_;
     intset config_;
     intset nodes_left_;
     intset f_nodes_;
     unsigned count_ = 0;
     unsigned calls_ = 0;
-
-    std::function<void(const intset &)> output_cb_;
-    std::function<void(const intset &, int, bool)> update_cb_;
 };
 
-class MISFinder : public MISFinderBase {
+using MISOutputCallback = std::function<void(const intset &)>;
+using MISUpdateCallback = std::function<void(const intset &, int, bool)>;
+
+// The engines take the type of the callbacks as template parameters, so
+// that the callbacks can be inlined in the search. MISFinder,
+// MISFinderBK and MISFinderTomita are the instances for std::function.
+
+template <typename OutputCb = MISOutputCallback,
+          typename UpdateCb = MISUpdateCallback>
+class BasicMISFinder : public MISFinderBase {
 public:
-    MISFinder(const Graph *graph,
-              std::function<void(const intset &)> output_cb,
-              std::function<void(const intset &, int, bool)> update_cb);
+    BasicMISFinder(const Graph *graph, OutputCb output_cb, UpdateCb update_cb);
 
 private:
     void visit();
 
+    OutputCb output_cb_;
+    UpdateCb update_cb_;
     std::vector<int> num_edges_;
     int g_num_edges_;
+
+    // a node of the search tree, before its first child, between its
+    // children or after its second child
+    struct Frame {
+        enum State { ENTER, FIRST, SECOND } state;
+        int id;
+        bool is_f_node;
+    };
+    std::vector<Frame> stack_;
+};
+
+template <typename OutputCb = MISOutputCallback,
+          typename UpdateCb = MISUpdateCallback>
+class BasicMISFinderBK : public MISFinderBase {
+public:
+    BasicMISFinderBK(const Graph *graph,
+                     OutputCb output_cb,
+                     UpdateCb update_cb);
+
+private:
+    void visit();
+
+    OutputCb output_cb_;
+    UpdateCb update_cb_;
+    // updates of nodes_left_ and f_nodes_ below each level
+    Trail trail_;
+    // the nodes tried by the frames, each frame owns a range after the
+    // ranges of its ancestors
+    std::vector<int> ids_;
+
+    // a node of the search tree, before its children, before the child
+    // of the node ids_[next] or after it. Its nodes are the range
+    // [first, last) of ids_.
+    struct Frame {
+        enum State { ENTER, NEXT, RETURN } state;
+        unsigned first;
+        unsigned next;
+        unsigned last;
+        size_t mark;
+    };
+    std::vector<Frame> stack_;
 };
 
-class MISFinderBK : public MISFinderBase {
+// Bron-Kerbosch with the pivot rule of Tomita et al. on the complement
+// graph, the top level visits the nodes in degeneracy order (Eppstein
+// et al.). The candidate sets are rows of the adjacency matrix.
+template <typename OutputCb = MISOutputCallback,
+          typename UpdateCb = MISUpdateCallback>
+class BasicMISFinderTomita : public MISFinderBase {
 public:
-    MISFinderBK(const Graph *graph,
-                std::function<void(const intset &)> output_cb,
-                std::function<void(const intset &, int, bool)> update_cb);
+    BasicMISFinderTomita(const Graph *graph,
+                         OutputCb output_cb,
+                         UpdateCb update_cb);
 
 private:
     void visit();
+
+    OutputCb output_cb_;
+    UpdateCb update_cb_;
+    // dense copy of the graph if it uses adjacency lists
+    std::unique_ptr<Graph> dense_;
+    // candidate, excluded and branching nodes at each depth
+    std::vector<intset> P_;
+    std::vector<intset> X_;
+    std::vector<intset> B_;
+
+    // a node of the search tree at depth stack_.size(), before its
+    // children, before the child of the node id or after it
+    struct Frame {
+        enum State { ENTER, NEXT, RETURN } state;
+        int id;
+    };
+    std::vector<Frame> stack_;
 };
+
+using MISFinder = BasicMISFinder<>;
+using MISFinderBK = BasicMISFinderBK<>;
+using MISFinderTomita = BasicMISFinderTomita<>;
+
+template <typename OutputCb, typename UpdateCb>
+BasicMISFinder<OutputCb, UpdateCb>::BasicMISFinder(const Graph *graph,
+                                                   OutputCb output_cb,
+                                                   UpdateCb update_cb)
+    : MISFinderBase(graph)
+    , output_cb_(std::move(output_cb))
+    , update_cb_(std::move(update_cb))
+{
+    auto size = graph_->num_nodes();
+    num_edges_.resize(size);
+    g_num_edges_ = 0;
+    for (int i = 0; i < size; i++) {
+        config_.add(i);
+        num_edges_[i] = graph_->degree(i);
+        g_num_edges_ += num_edges_[i];
+        update_cb_(config_, i, true);
+    }
+    visit();
+}
+
+// depth-first search with an explicit stack: the first child of a node
+// removes a node from the set, the second child keeps it
+template <typename OutputCb, typename UpdateCb>
+void BasicMISFinder<OutputCb, UpdateCb>::visit()
+{
+    stack_.reserve(graph_->num_nodes() + 1);
+    stack_.push_back({Frame::ENTER, -1, false});
+    while (!stack_.empty()) {
+        Frame &frame = stack_.back();
+        int id = frame.id;
+        switch (frame.state) {
+            case Frame::ENTER: {
+                calls_++;
+
+                if (g_num_edges_ == 0) {
+                    output_cb_(config_);
+                    count_++;
+                    stack_.pop_back();
+                    break;
+                }
+
+                id = f_nodes_.minimum();
+                if (id != -1) {
+                    f_nodes_.remove(id);
+                    frame.is_f_node = true;
+                } else {
+                    int max_edges = 0;
+                    for (const auto &u : nodes_left_) {
+                        if (num_edges_[u] > max_edges) {
+                            max_edges = num_edges_[u];
+                            id = u;
+                        }
+                    }
+                }
+                if (id == -1) {
+                    stack_.pop_back();
+                    break;
+                }
+                frame.id = id;
+                frame.state = Frame::FIRST;
+
+                nodes_left_.remove(id);
+
+                config_.remove(id);
+                update_cb_(config_, id, false);
+
+                bool prune = false;
+                g_num_edges_ -= 2 * num_edges_[id];
+                graph_->for_each_edge(id, [this, &prune](int v) {
+                    num_edges_[v]--;
+
+                    if (num_edges_[v] == 0 && !config_.contains(v))
+                        prune = true;
+                });
+                if (!prune)
+                    stack_.push_back({Frame::ENTER, -1, false});
+                else
+                    f_nodes_.clear();
+                break;
+            }
+            case Frame::FIRST:
+                config_.add(id);
+                update_cb_(config_, id, true);
+
+                frame.state = Frame::SECOND;
+                g_num_edges_ += 2 * num_edges_[id];
+                if (!frame.is_f_node) {
+                    graph_->for_each_edge(id, [this](int v) {
+                        num_edges_[v]++;
+
+                        if (config_.contains(v)) {
+                            assert(nodes_left_.contains(v));
+                            f_nodes_.add(v);
+                        }
+                    });
+                    stack_.push_back({Frame::ENTER, -1, false});
+                } else {
+                    graph_->for_each_edge(id,
+                                          [this](int v) { num_edges_[v]++; });
+                }
+                break;
+            case Frame::SECOND:
+                nodes_left_.add(id);
+                stack_.pop_back();
+                break;
+        }
+    }
+}
+
+template <typename OutputCb, typename UpdateCb>
+BasicMISFinderBK<OutputCb, UpdateCb>::BasicMISFinderBK(const Graph *graph,
+                                                       OutputCb output_cb,
+                                                       UpdateCb update_cb)
+    : MISFinderBase(graph)
+    , output_cb_(std::move(output_cb))
+    , update_cb_(std::move(update_cb))
+{
+    visit();
+}
+
+// depth-first search with an explicit stack
+template <typename OutputCb, typename UpdateCb>
+void BasicMISFinderBK<OutputCb, UpdateCb>::visit()
+{
+    stack_.reserve(graph_->num_nodes() + 1);
+    stack_.push_back({Frame::ENTER, 0, 0, 0, 0});
+    while (!stack_.empty()) {
+        Frame &frame = stack_.back();
+        switch (frame.state) {
+            case Frame::ENTER: {
+                calls_++;
+
+                if (nodes_left_.minimum() == -1 && f_nodes_.minimum() == -1) {
+                    output_cb_(config_);
+                    count_++;
+                    stack_.pop_back();
+                    break;
+                }
+
+                int best_score;
+                int best_id = -1;
+                find_pivot(
+                    *graph_, nodes_left_, nodes_left_, best_id, best_score);
+                find_pivot(*graph_, f_nodes_, nodes_left_, best_id, best_score);
+
+                frame.first = frame.next = ids_.size();
+                graph_->for_each_edge(best_id, [this](int v) {
+                    if (nodes_left_.contains(v))
+                        ids_.push_back(v);
+                });
+                if (nodes_left_.contains(best_id))
+                    ids_.push_back(best_id);
+                frame.last = ids_.size();
+                frame.state = Frame::NEXT;
+                break;
+            }
+            // nodes_left_ and f_nodes_ are the candidate and excluded
+            // nodes of this level between the children
+            case Frame::NEXT: {
+                if (frame.next == frame.last) {
+                    ids_.resize(frame.first);
+                    stack_.pop_back();
+                    break;
+                }
+                int id = ids_[frame.next];
+                frame.mark = trail_.mark();
+                trail_.remove(nodes_left_, id);
+                graph_->remove_neighbors(id, nodes_left_, trail_);
+                graph_->remove_neighbors(id, f_nodes_, trail_);
+
+                config_.add(id);
+                update_cb_(config_, id, true);
+
+                frame.state = Frame::RETURN;
+                stack_.push_back({Frame::ENTER, 0, 0, 0, 0});
+                break;
+            }
+            case Frame::RETURN: {
+                int id = ids_[frame.next++];
+                config_.remove(id);
+                update_cb_(config_, id, false);
+
+                trail_.undo(frame.mark);
+                trail_.remove(nodes_left_, id);
+                trail_.add(f_nodes_, id);
+                frame.state = Frame::NEXT;
+                break;
+            }
+        }
+    }
+}
+
+template <typename OutputCb, typename UpdateCb>
+BasicMISFinderTomita<OutputCb, UpdateCb>::BasicMISFinderTomita(
+    const Graph *graph,
+    OutputCb output_cb,
+    UpdateCb update_cb)
+    : MISFinderBase(graph)
+    , output_cb_(std::move(output_cb))
+    , update_cb_(std::move(update_cb))
+{
+    if (!graph_->is_dense()) {
+        dense_ = std::make_unique<Graph>(*graph_);
+        dense_->set_dense(true);
+        graph_ = dense_.get();
+    }
+    int n = graph_->num_nodes();
+    if (n == 0) {
+        output_cb_(config_);
+        count_++;
+        return;
+    }
+    for (int i = 0; i <= n; i++) {
+        P_.emplace_back(n);
+        X_.emplace_back(n);
+        B_.emplace_back(n);
+    }
+
+    // the nodes after u in the order are the candidates, the nodes
+    // before u are excluded
+    intset later = nodes_left_;
+    intset earlier(n);
+    for (int u : degeneracy_order(*graph_)) {
+        later.remove(u);
+        P_[1] = later;
+        P_[1].remove(graph_->row(u));
+        X_[1] = earlier;
+        X_[1].remove(graph_->row(u));
+        earlier.add(u);
+
+        config_.add(u);
+        update_cb_(config_, u, true);
+        visit();
+        config_.remove(u);
+        update_cb_(config_, u, false);
+    }
+}
+
+// depth-first search with an explicit stack, from the sets at depth 1
+template <typename OutputCb, typename UpdateCb>
+void BasicMISFinderTomita<OutputCb, UpdateCb>::visit()
+{
+    stack_.reserve(graph_->num_nodes());
+    stack_.push_back({Frame::ENTER, -1});
+    while (!stack_.empty()) {
+        unsigned depth = stack_.size();
+        Frame &frame = stack_.back();
+        intset &P = P_[depth];
+        intset &X = X_[depth];
+        intset &B = B_[depth];
+        switch (frame.state) {
+            case Frame::ENTER: {
+                calls_++;
+
+                if (P.minimum() == -1) {
+                    if (X.minimum() == -1) {
+                        output_cb_(config_);
+                        count_++;
+                    }
+                    stack_.pop_back();
+                    break;
+                }
+
+                int pivot = find_tomita_pivot(*graph_, P, X);
+                B = P;
+                B.intersect(graph_->row(pivot));
+                if (P.contains(pivot))
+                    B.add(pivot);
+                frame.id = B.minimum();
+                frame.state = Frame::NEXT;
+                break;
+            }
+            case Frame::NEXT: {
+                int id = frame.id;
+                if (id == -1) {
+                    stack_.pop_back();
+                    break;
+                }
+                P_[depth + 1] = P;
+                P_[depth + 1].remove(id).remove(graph_->row(id));
+                X_[depth + 1] = X;
+                X_[depth + 1].remove(graph_->row(id));
+
+                config_.add(id);
+                update_cb_(config_, id, true);
+
+                frame.state = Frame::RETURN;
+                stack_.push_back({Frame::ENTER, -1});
+                break;
+            }
+            case Frame::RETURN: {
+                int id = frame.id;
+                config_.remove(id);
+                update_cb_(config_, id, false);
+
+                P.remove(id);
+                X.add(id);
+                frame.id = B.find_next(id + 1);
+                frame.state = Frame::NEXT;
+                break;
+            }
+        }
+    }
+}
+
+extern template class BasicMISFinder<>;
+extern template class BasicMISFinderBK<>;
+extern template class BasicMISFinderTomita<>;
@@ -24,15 +24,19 @@
 
 #pragma once
 
+#include "intset_stats.h"
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <limits>
 #include <memory>
 
 class intset {
-private:
+public:
     using block = unsigned long;
     static const unsigned bits_per_block = std::numeric_limits<block>::digits;
+
+private:
     static unsigned block_index(unsigned n) { return n / bits_per_block; }
     static unsigned bit_index(unsigned n) { return n % bits_per_block; }
     static block bit_mask(unsigned n) { return block(1) << bit_index(n); }
@@ -40,13 +44,17 @@ private:
     std::unique_ptr<block[]> data_;
     unsigned num_bits_;
 
+public:
+    unsigned max_size() const { return num_bits_; }
+
+    // the blocks of the set, element n is bit n % bits_per_block of
+    // block n / bits_per_block
     unsigned num_blocks() const
     {
         return (num_bits_ + bits_per_block - 1) / bits_per_block;
     }
-
-public:
-    unsigned max_size() const { return num_bits_; }
+    block *data() { return data_.get(); }
+    const block *data() const { return data_.get(); }
 
     intset(unsigned size)
     {
@@ -56,6 +64,7 @@ public:
 
     intset(const intset &s)
     {
+        INTSET_COUNT(COPY, s.num_blocks());
         num_bits_ = s.num_bits_;
         data_ = std::make_unique<block[]>(num_blocks());
         for (unsigned i = 0; i < num_blocks(); i++)
@@ -64,6 +73,7 @@ public:
 
     intset &operator=(const intset &s)
     {
+        INTSET_COUNT(COPY, s.num_blocks());
         if (num_blocks() != s.num_blocks()) {
             auto data = std::make_unique<block[]>(s.num_blocks());
             data_ = std::move(data);
@@ -76,12 +86,14 @@ public:
 
     intset(intset &&s) noexcept
     {
+        INTSET_COUNT(MOVE, 0);
         data_.swap(s.data_);
         std::swap(num_bits_, s.num_bits_);
     }
 
     intset &operator=(intset &&s) noexcept
     {
+        INTSET_COUNT(MOVE, 0);
         data_.swap(s.data_);
         std::swap(num_bits_, s.num_bits_);
         return *this;
@@ -102,8 +114,19 @@ public:
         return true;
     }
 
+    // equal sets have the same hash, whatever their max_size
+    size_t hash() const
+    {
+        size_t h = 0;
+        for (unsigned i = 0; i < num_blocks(); i++)
+            if (data_[i])
+                h += (data_[i] ^ i) * 0x9e3779b97f4a7c15;
+        return h;
+    }
+
     intset &add(unsigned n)
     {
+        INTSET_COUNT(ADD, 1);
         assert(n < num_bits_);
         data_[block_index(n)] |= bit_mask(n);
         return *this;
@@ -112,6 +135,7 @@ public:
     intset &add(const intset &s)
     {
         assert(num_bits_ == s.num_bits_);
+        INTSET_COUNT(ADD, num_blocks());
         for (unsigned i = 0; i < num_blocks(); i++)
             data_[i] |= s.data_[i];
         return *this;
@@ -119,6 +143,7 @@ public:
 
     intset &remove(unsigned n)
     {
+        INTSET_COUNT(REMOVE, 1);
         assert(n < num_bits_);
         data_[block_index(n)] &= ~bit_mask(n);
         return *this;
@@ -127,6 +152,7 @@ public:
     intset &remove(const intset &s)
     {
         assert(num_bits_ == s.num_bits_);
+        INTSET_COUNT(REMOVE, num_blocks());
         for (unsigned i = 0; i < num_blocks(); i++)
             data_[i] &= ~s.data_[i];
         return *this;
@@ -148,27 +174,39 @@ public:
 
     bool contains(unsigned n) const
     {
+        INTSET_COUNT(CONTAINS, 1);
         return data_[block_index(n)] & bit_mask(n);
     }
 
     bool is_subset_of(const intset &s) const
     {
         auto n = std::min({num_blocks(), s.num_blocks()});
-        for (unsigned i = 0; i < n; i++)
-            if (data_[i] & ~s.data_[i])
+        for (unsigned i = 0; i < n; i++) {
+            if (data_[i] & ~s.data_[i]) {
+                INTSET_COUNT(IS_SUBSET_OF, i + 1);
                 return false;
-        for (unsigned i = n; i < num_blocks(); i++)
-            if (data_[i])
+            }
+        }
+        for (unsigned i = n; i < num_blocks(); i++) {
+            if (data_[i]) {
+                INTSET_COUNT(IS_SUBSET_OF, i + 1);
                 return false;
+            }
+        }
+        INTSET_COUNT(IS_SUBSET_OF, num_blocks());
         return true;
     }
 
     bool intersects(const intset &s) const
     {
         auto n = std::min({num_blocks(), s.num_blocks()});
-        for (unsigned i = 0; i < n; i++)
-            if (data_[i] & s.data_[i])
+        for (unsigned i = 0; i < n; i++) {
+            if (data_[i] & s.data_[i]) {
+                INTSET_COUNT(INTERSECTS, i + 1);
                 return true;
+            }
+        }
+        INTSET_COUNT(INTERSECTS, n);
         return false;
     }
 
@@ -190,8 +228,19 @@ public:
         return size;
     }
 
+    // equivalent to (*this & s).size()
+    unsigned intersection_size(const intset &s) const
+    {
+        auto n = std::min({num_blocks(), s.num_blocks()});
+        unsigned size = 0;
+        for (unsigned i = 0; i < n; i++)
+            size += __builtin_popcountl(data_[i] & s.data_[i]);
+        return size;
+    }
+
     unsigned find_next(unsigned elem) const
     {
+        INTSET_COUNT(FIND_NEXT, elem < num_bits_);
         if (elem >= num_bits_)
             return -1;
         unsigned long x = data_[block_index(elem)];
@@ -202,6 +251,7 @@ public:
             elem += bits_per_block;
             if (elem >= num_bits_)
                 return -1;
+            INTSET_BLOCKS(FIND_NEXT, 1);
             x = data_[block_index(elem)];
         }
         elem += __builtin_ctzl(x);
@@ -210,6 +260,15 @@ public:
         return elem;
     }
 
+    // equivalent to .add(lhs & rhs)
+    intset &add_intersection(const intset &lhs, const intset &rhs)
+    {
+        assert(num_bits_ == lhs.num_bits_ && num_bits_ == rhs.num_bits_);
+        for (unsigned i = 0; i < num_blocks(); i++)
+            data_[i] |= lhs.data_[i] & rhs.data_[i];
+        return *this;
+    }
+
     // equivalent to .intersects(lhs & rhs)
     bool intersects(const intset &lhs, const intset &rhs) const
     {
@@ -218,9 +277,13 @@ public:
             lhs.num_blocks(),
             rhs.num_blocks(),
         });
-        for (unsigned i = 0; i < n; i++)
-            if (data_[i] & lhs.data_[i] & rhs.data_[i])
+        for (unsigned i = 0; i < n; i++) {
+            if (data_[i] & lhs.data_[i] & rhs.data_[i]) {
+                INTSET_COUNT(INTERSECTS, i + 1);
                 return true;
+            }
+        }
+        INTSET_COUNT(INTERSECTS, n);
         return false;
     }
 
@@ -232,9 +295,13 @@ public:
             lhs.num_blocks(),
             rhs.num_blocks(),
         });
-        for (unsigned i = 0; i < n; i++)
-            if (data_[i] & (lhs.data_[i] | rhs.data_[i]))
+        for (unsigned i = 0; i < n; i++) {
+            if (data_[i] & (lhs.data_[i] | rhs.data_[i])) {
+                INTSET_COUNT(INTERSECTS_UNION, i + 1);
                 return true;
+            }
+        }
+        INTSET_COUNT(INTERSECTS_UNION, n);
         return false;
     }
 
@@ -246,9 +313,13 @@ public:
             lhs.num_blocks(),
             rhs.num_blocks(),
         });
-        for (unsigned i = 0; i < n; i++)
-            if (data_[i] & (lhs.data_[i] & ~rhs.data_[i]))
+        for (unsigned i = 0; i < n; i++) {
+            if (data_[i] & (lhs.data_[i] & ~rhs.data_[i])) {
+                INTSET_COUNT(INTERSECTS_DIFFERENCE, i + 1);
                 return true;
+            }
+        }
+        INTSET_COUNT(INTERSECTS_DIFFERENCE, n);
         return false;
     }
 
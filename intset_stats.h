@@ -0,0 +1,136 @@
+#pragma once
+
+// Counters of the operations on intsets, for the builds configured with
+// -DMVS_INTSET_STATS=ON. Each operation is counted with the number of
+// blocks it touched in the current phase, and the counts of each phase
+// are written to standard error at exit. The phase is global, the
+// operations of all the threads are counted in it. In the other builds
+// the macros expand to nothing.
+#ifdef MVS_INTSET_STATS
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+namespace intset_stats {
+
+enum Op {
+    ADD,
+    REMOVE,
+    CONTAINS,
+    INTERSECTS,
+    INTERSECTS_UNION,
+    INTERSECTS_DIFFERENCE,
+    IS_SUBSET_OF,
+    FIND_NEXT,
+    COPY,
+    MOVE,
+    NUM_OPS
+};
+
+struct Stats {
+    static const unsigned max_phases = 16;
+
+    struct Counters {
+        std::atomic<unsigned long> calls[NUM_OPS];
+        std::atomic<unsigned long> blocks[NUM_OPS];
+    };
+
+    Counters counters[max_phases] = {};
+    const char *names[max_phases] = {"other"};
+    unsigned num_phases = 1;
+    std::atomic<unsigned> phase{0};
+    std::mutex mutex;
+
+    // the index of the phase 'name', the last one if there are too many
+    unsigned find(const char *name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (unsigned i = 0; i < num_phases; i++)
+            if (!strcmp(names[i], name))
+                return i;
+        if (num_phases == max_phases)
+            return max_phases - 1;
+        names[num_phases] = name;
+        return num_phases++;
+    }
+
+    ~Stats()
+    {
+        static const char *op_names[NUM_OPS] = {
+            "add",
+            "remove",
+            "contains",
+            "intersects",
+            "intersects_union",
+            "intersects_difference",
+            "is_subset_of",
+            "find_next",
+            "copy",
+            "move",
+        };
+        fprintf(stderr, "{\"intset_stats\": {");
+        const char *sep = "";
+        for (unsigned i = 0; i < num_phases; i++) {
+            fprintf(stderr, "%s\"%s\": {", sep, names[i]);
+            for (unsigned op = 0; op < NUM_OPS; op++)
+                fprintf(stderr,
+                        "%s\"%s\": {\"calls\": %lu, \"blocks\": %lu}",
+                        op ? ", " : "",
+                        op_names[op],
+                        counters[i].calls[op].load(),
+                        counters[i].blocks[op].load());
+            fprintf(stderr, "}");
+            sep = ", ";
+        }
+        fprintf(stderr, "}}\n");
+    }
+};
+
+inline Stats &stats()
+{
+    static Stats stats;
+    return stats;
+}
+
+inline void count(Op op, unsigned long calls, unsigned long blocks)
+{
+    auto &s = stats();
+    auto &counters = s.counters[s.phase.load(std::memory_order_relaxed)];
+    counters.calls[op].fetch_add(calls, std::memory_order_relaxed);
+    counters.blocks[op].fetch_add(blocks, std::memory_order_relaxed);
+}
+
+// sets the phase for the lifetime of the object
+class Phase {
+    unsigned prev_;
+
+public:
+    Phase(const char *name)
+    {
+        auto &s = stats();
+        prev_ = s.phase.exchange(s.find(name));
+    }
+    ~Phase() { stats().phase = prev_; }
+    Phase(const Phase &) = delete;
+    Phase &operator=(const Phase &) = delete;
+};
+
+} // namespace intset_stats
+
+// an operation that touched 'blocks' blocks
+#define INTSET_COUNT(op, blocks) \
+    intset_stats::count(intset_stats::op, 1, blocks)
+// more blocks touched by the last operation
+#define INTSET_BLOCKS(op, blocks) \
+    intset_stats::count(intset_stats::op, 0, blocks)
+#define INTSET_PHASE(name) intset_stats::Phase intset_phase_(name)
+
+#else
+
+#define INTSET_COUNT(op, blocks)
+#define INTSET_BLOCKS(op, blocks)
+#define INTSET_PHASE(name)
+
+#endif
@@ -16,6 +16,8 @@
 #include "io.h"
 #include "dfg.h"
 #include "intset.h"
+#include <algorithm>
+#include <limits>
 
 static bool is_permanent(const DFG &dfg,
                          const intset &config,
@@ -104,3 +106,272 @@ int IOAnalysis::num_perm_out(const IOSubgraph &config, const intset &nodes_left)
             n++;
     return n;
 }
+
+IOFlow::IOFlow(int num_nodes)
+    : source_(2 * num_nodes)
+    , sink_(2 * num_nodes + 1)
+    , permanent_(num_nodes)
+    , ancestors_(num_nodes)
+    , descendants_(num_nodes)
+    , reach_(num_nodes)
+    , head_(2 * num_nodes + 2, -1)
+    , visited_(2 * num_nodes + 2)
+    , parent_(2 * num_nodes + 2)
+{
+}
+
+void IOFlow::clear()
+{
+    for (auto &arc : arcs_)
+        head_[arc.to] = -1;
+    head_[source_] = -1;
+    arcs_.clear();
+}
+
+void IOFlow::add_edge(int u, int v, double capacity)
+{
+    arcs_.push_back({v, head_[u], capacity});
+    head_[u] = arcs_.size() - 1;
+    arcs_.push_back({u, head_[v], 0});
+    head_[v] = arcs_.size() - 1;
+}
+
+void IOFlow::push(int e, double amount)
+{
+    arcs_[e].capacity -= amount;
+    arcs_[e ^ 1].capacity += amount;
+}
+
+// Augment along paths found by depth-first searches from the source
+// until the flow exceeds limit. The nodes visited by a search that
+// fails to reach the sink cannot reach it for the rest of the phase,
+// so that a phase costs as much as one search of the whole network.
+int IOFlow::max_flow(int limit)
+{
+    int flow = 0;
+    bool found = true;
+    while (found && flow <= limit) {
+        found = false;
+        if (++stamp_ == 0) {
+            std::fill(visited_.begin(), visited_.end(), 0);
+            stamp_ = 1;
+        }
+        visited_[source_] = stamp_;
+        // the current arc of each node of the path from the source
+        stack_.assign(1, head_[source_]);
+        while (!stack_.empty() && flow <= limit) {
+            int e = stack_.back();
+            while (e != -1 && (arcs_[e].capacity == 0 ||
+                               visited_[arcs_[e].to] == stamp_))
+                e = arcs_[e].next;
+            stack_.back() = e;
+            if (e == -1) {
+                stack_.pop_back();
+                continue;
+            }
+            int v = arcs_[e].to;
+            if (v == sink_) {
+                for (auto &arc : stack_)
+                    push(arc, 1);
+                flow++;
+                found = true;
+                stack_.assign(1, head_[source_]);
+                continue;
+            }
+            visited_[v] = stamp_;
+            stack_.push_back(head_[v]);
+        }
+    }
+    return flow;
+}
+
+// Edmonds-Karp: augment along the shortest paths found by breadth-first
+// searches from the source, until the flow exceeds limit. The arcs with
+// a capacity of at most eps are saturated.
+double IOFlow::max_flow(double limit, double eps)
+{
+    double flow = 0;
+    while (flow <= limit) {
+        if (++stamp_ == 0) {
+            std::fill(visited_.begin(), visited_.end(), 0);
+            stamp_ = 1;
+        }
+        visited_[source_] = stamp_;
+        stack_.assign(1, source_);
+        for (size_t k = 0; k < stack_.size() && visited_[sink_] != stamp_;
+             k++) {
+            for (int e = head_[stack_[k]]; e != -1; e = arcs_[e].next) {
+                int v = arcs_[e].to;
+                if (arcs_[e].capacity > eps && visited_[v] != stamp_) {
+                    visited_[v] = stamp_;
+                    parent_[v] = e;
+                    stack_.push_back(v);
+                }
+            }
+        }
+        if (visited_[sink_] != stamp_)
+            break;
+        double amount = std::numeric_limits<double>::infinity();
+        for (int v = sink_; v != source_; v = arcs_[parent_[v] ^ 1].to)
+            amount = std::min(amount, arcs_[parent_[v]].capacity);
+        for (int v = sink_; v != source_; v = arcs_[parent_[v] ^ 1].to)
+            push(parent_[v], amount);
+        flow += amount;
+    }
+    return flow;
+}
+
+bool IOFlow::exceeds(const IOSubgraph &config,
+                     const intset &nodes_left,
+                     int max_num_in,
+                     int max_num_out,
+                     double dels)
+{
+    auto &dfg = config.dfg();
+    // the nodes that are no longer removable, and those between two of
+    // them, are the permanent nodes. Their ancestors and descendants
+    // are those of the first ones.
+    permanent_ = config.nodes();
+    permanent_.remove(nodes_left);
+    ancestors_.clear();
+    descendants_.clear();
+    for (auto u : permanent_) {
+        ancestors_.add(dfg.pred(u));
+        descendants_.add(dfg.succ(u));
+    }
+    ancestors_.intersect(config.nodes());
+    descendants_.intersect(config.nodes());
+    permanent_.add_intersection(ancestors_, descendants_);
+
+    if (config.num_in() > max_num_in) {
+        reach_ = ancestors_;
+        reach_.remove(permanent_);
+        int num_paths = num_in_paths(config, max_num_in);
+        if (num_paths > max_num_in)
+            return true;
+        // with fewer paths, the bound on the weight is negative. It is
+        // at most the weight of the cut found with the paths.
+        if (num_paths == max_num_in && cut_weight_ > dels &&
+            in_cut_weight(config, max_num_in, dels) > dels)
+            return true;
+    }
+    // the permanent nodes are a cut of the paths to the outputs
+    if (config.num_out() > max_num_out && permanent_.size() > max_num_out) {
+        reach_ = descendants_;
+        reach_.add(permanent_);
+        if (num_out_paths(config, max_num_out) > max_num_out)
+            return true;
+    }
+    return false;
+}
+
+// the network of the paths from the inputs to the permanent nodes,
+// through the ancestors of the permanent nodes in reach_. Only the nodes
+// can be cut: with lambda = 0 their capacity is 1, otherwise it is
+// lambda for an input and lambda plus the weight for a node of reach_.
+void IOFlow::in_network(const IOSubgraph &config, double lambda)
+{
+    auto &dfg = config.dfg();
+    const double inf = std::numeric_limits<double>::infinity();
+    clear();
+    auto add_edges = [&](int u, double capacity) {
+        bool edges = false;
+        for (auto &w : dfg.out_edges(u)) {
+            if (permanent_.contains(w) || reach_.contains(w)) {
+                add_edge(out(u), in(w), inf);
+                edges = true;
+            }
+        }
+        if (edges)
+            add_edge(in(u), out(u), capacity);
+        return edges;
+    };
+    for (auto &v : config.inputs())
+        if (add_edges(v, lambda ? lambda : 1))
+            add_edge(source_, in(v), inf);
+    for (auto u : reach_)
+        add_edges(u, lambda ? lambda + dfg.weight(u) : 1);
+    for (auto u : permanent_)
+        add_edge(in(u), sink_, inf);
+}
+
+// the paths from the inputs to the permanent nodes. If there are at
+// most limit, cut_weight_ is the weight of a cut with as many nodes.
+int IOFlow::num_in_paths(const IOSubgraph &config, int limit)
+{
+    auto &dfg = config.dfg();
+    // the nodes with an edge to a permanent node are a cut
+    auto has_permanent_successor = [this, &dfg](int u) {
+        for (auto &w : dfg.out_edges(u))
+            if (permanent_.contains(w))
+                return true;
+        return false;
+    };
+    int cut = 0;
+    cut_weight_ = 0;
+    for (auto &v : config.inputs())
+        if (has_permanent_successor(v))
+            cut++;
+    for (auto u : reach_) {
+        if (has_permanent_successor(u)) {
+            cut++;
+            cut_weight_ += dfg.weight(u);
+        }
+    }
+    if (cut <= limit)
+        return cut;
+
+    in_network(config, 0);
+    int flow = max_flow(limit);
+    // the nodes reached by the last search of max_flow are on the
+    // source side of a minimum cut
+    cut_weight_ = 0;
+    if (flow <= limit)
+        for (auto u : reach_)
+            if (visited_[in(u)] == stamp_ && visited_[out(u)] != stamp_)
+                cut_weight_ += dfg.weight(u);
+    return flow;
+}
+
+// With lambda larger than the weight of reach_, a minimum cut of the
+// weighted network has the fewest nodes, and then the least weight. If
+// it has limit nodes, its capacity minus limit * lambda is the minimum
+// weight of a cut with at most limit nodes, otherwise it is negative.
+// Any flow is at most the minimum cut, so the search stops once the
+// bound exceeds dels.
+double IOFlow::in_cut_weight(const IOSubgraph &config, int limit, double dels)
+{
+    double lambda = 1;
+    for (auto u : reach_)
+        lambda += config.dfg().weight(u);
+    in_network(config, lambda);
+    double eps = lambda * 1e-9;
+    return max_flow(limit * lambda + dels + eps, eps) - limit * lambda - eps;
+}
+
+// the paths from the permanent nodes to the outputs, through their
+// descendants in reach_
+int IOFlow::num_out_paths(const IOSubgraph &config, int limit)
+{
+    auto &dfg = config.dfg();
+    int cut = 0;
+    for (auto &o : config.outputs())
+        if (reach_.contains(o))
+            cut++;
+    if (cut <= limit)
+        return cut;
+
+    clear();
+    for (auto u : reach_) {
+        if (permanent_.contains(u))
+            add_edge(source_, in(u), 1);
+        add_edge(in(u), out(u), 1);
+        for (auto &w : dfg.out_edges(u))
+            if (reach_.contains(w))
+                add_edge(out(u), in(w), 1);
+    }
+    for (auto &o : config.outputs())
+        if (reach_.contains(o))
+            add_edge(out(o), sink_, 1);
+    return max_flow(limit);
+}
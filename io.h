@@ -1,7 +1,9 @@
 #pragma once
 
 #include "dfg.h"
+#include "intset.h"
 #include "vset.h"
+#include <vector>
 
 class IOAnalysis {
 public:
@@ -22,3 +24,61 @@ private:
     vmap<int, double> inputs_;
     vmap<int, double> rnodes_;
 };
+
+// Lower bounds on the subgraphs of config that keep the permanent
+// nodes. Each path from an input of config to a permanent node enters
+// such a subgraph through one of its inputs, and each path from a
+// permanent node to an output of config leaves it through one of its
+// outputs, so the maximum number of paths with no node in common bounds
+// the number of inputs and outputs. The inputs on the paths are a cut,
+// made of inputs of config and of removed nodes, so the minimum weight
+// of a cut with at most max_num_in nodes bounds the weight of the
+// removed nodes. The bounds are found by augmenting flows on the graph
+// with each node split in two.
+class IOFlow {
+public:
+    IOFlow(int num_nodes);
+
+    // true if the bound on the inputs is larger than max_num_in, the
+    // one on the outputs is larger than max_num_out, or the one on the
+    // weight of the removed nodes is larger than dels
+    bool exceeds(const IOSubgraph &config,
+                 const intset &nodes_left,
+                 int max_num_in,
+                 int max_num_out,
+                 double dels);
+
+private:
+    void in_network(const IOSubgraph &config, double lambda);
+    int num_in_paths(const IOSubgraph &config, int limit);
+    double in_cut_weight(const IOSubgraph &config, int limit, double dels);
+    int num_out_paths(const IOSubgraph &config, int limit);
+    void clear();
+    void add_edge(int u, int v, double capacity);
+    void push(int e, double amount);
+    int max_flow(int limit);
+    double max_flow(double limit, double eps);
+    int in(int u) const { return 2 * u; }
+    int out(int u) const { return 2 * u + 1; }
+
+    int source_;
+    int sink_;
+    intset permanent_;
+    intset ancestors_;
+    intset descendants_;
+    intset reach_;
+    // edges in forward-star form, each followed by its reverse
+    struct Arc {
+        int to;
+        int next;
+        double capacity;
+    };
+    std::vector<Arc> arcs_;
+    std::vector<int> head_;
+    std::vector<unsigned> visited_;
+    unsigned stamp_ = 0;
+    std::vector<int> stack_;
+    double cut_weight_;
+    // the arc to each node of the last breadth-first search
+    std::vector<int> parent_;
+};
@@ -46,9 +46,10 @@ static void find_mis(Graph *graph)
 int main(int argc, char **argv)
 {
     bool use_bk = false;
+    bool use_tomita = false;
     bool invert = false;
     int c;
-    while ((c = getopt(argc, argv, "bi")) != -1) {
+    while ((c = getopt(argc, argv, "bit")) != -1) {
         switch (c) {
             case 'b':
                 use_bk = true;
@@ -56,6 +57,9 @@ int main(int argc, char **argv)
             case 'i':
                 invert = true;
                 break;
+            case 't':
+                use_tomita = true;
+                break;
         }
     }
 
@@ -63,7 +67,9 @@ int main(int argc, char **argv)
     if (invert)
         graph->invert();
 
-    if (use_bk)
+    if (use_tomita)
+        find_mis<MISFinderTomita>(graph.get());
+    else if (use_bk)
         find_mis<MISFinderBK>(graph.get());
     else
         find_mis<MISFinder>(graph.get());
@@ -17,64 +17,103 @@
 #include "dfg.h"
 #include "mvs.h"
 #include "nlohmann/json.hpp"
+#include "result.h"
+#include "split.h"
+#include "transform.h"
 #include <chrono>
 #include <climits>
 #include <cstdint>
 #include <cstdio>
+#include <exception>
+#include <fstream>
+#include <getopt.h>
 #include <iostream>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <unistd.h>
-
-static bool parse_flags(const std::string &str, uint8_t &flags)
-{
-    flags = 0xff;
-    for (auto &field : split(str, ',')) {
-        int v;
-        if (!parse_integer(field, v, 1, 5))
-            return false;
-        flags &= ~(uint8_t(1) << v);
-    }
-    return true;
-}
-
-static bool parse_itype(const std::string &str, MVSFinder::IterType &itype)
-{
-    if (str == "linear")
-        itype = MVSFinder::IterType::LINEAR;
-    else if (str == "linear-rev")
-        itype = MVSFinder::IterType::LINEAR_REV;
-    else if (str == "binary-search")
-        itype = MVSFinder::IterType::BINARY_SEARCH;
-    else
-        return false;
-    return true;
-}
+#include <vector>
 
 int main(int argc, char *argv[])
 {
     MVSFinder::IterType itype = MVSFinder::IterType::LINEAR_REV;
     bool use_weights = false;
+    bool reduce = false;
+    bool renumber = false;
+    bool split = false;
+    bool automorphisms = false;
+    bool binary = false;
+    bool binary_io = false;
     uint8_t flags = 0xff;
+    std::string checkpoint;
+    int checkpoint_interval = 60;
+    std::string resume;
+    std::vector<std::string> weight_files;
 
+    enum { CHECKPOINT = 256, CHECKPOINT_INTERVAL, RESUME };
+    static const struct option options[] = {
+        {"checkpoint", required_argument, nullptr, CHECKPOINT},
+        {"checkpoint-interval",
+         required_argument,
+         nullptr,
+         CHECKPOINT_INTERVAL},
+        {"resume", required_argument, nullptr, RESUME},
+        {nullptr, 0, nullptr, 0},
+    };
     int c;
-    while ((c = getopt(argc, argv, "i:o:w")) != -1) {
+    while ((c = getopt_long(argc, argv, "abBci:no:rwW:", options, nullptr)) !=
+           -1) {
         switch (c) {
+            case 'a':
+                automorphisms = true;
+                break;
+            case 'b':
+                binary = true;
+                break;
+            case 'B':
+                binary = binary_io = true;
+                break;
+            case 'c':
+                split = true;
+                break;
             case 'i':
                 if (!parse_itype(std::string(optarg), itype)) {
                     fprintf(stderr, "invalid iteration type\n");
                     return 1;
                 }
                 break;
+            case 'n':
+                renumber = true;
+                break;
             case 'o':
                 if (!parse_flags(std::string(optarg), flags)) {
                     fprintf(stderr, "invalid optimization list\n");
                     return 1;
                 }
                 break;
+            case 'r':
+                reduce = true;
+                break;
             case 'w':
                 use_weights = true;
                 break;
+            case 'W':
+                weight_files.push_back(optarg);
+                break;
+            case CHECKPOINT:
+                checkpoint = optarg;
+                break;
+            case CHECKPOINT_INTERVAL:
+                if (!parse_integer(
+                        std::string(optarg), checkpoint_interval, 0, INT_MAX)) {
+                    fprintf(stderr, "invalid checkpoint interval\n");
+                    return 1;
+                }
+                break;
+            case RESUME:
+                resume = optarg;
+                break;
         }
     }
     argc -= optind - 1;
@@ -88,9 +127,34 @@ int main(int argc, char *argv[])
                 "  \t\t\t  1-3 pruning criterion\n"
                 "  \t\t\t  4   clustering\n"
                 "  \t\t\t  5   improved weight computation\n"
+                "  \t\t\t  6   flow pruning criterion\n"
+                "  \t\t\t  7   heuristic lower bound on the weight\n"
                 "  -i ARG\t\tset iteration type, ARG can be 'linear', "
                 "'linear-rev' or  'binary-search'\n"
-                "  -w\t\t\tuse real weights\n");
+                "  -r\t\t\treduce the graph before the search\n"
+                "  -n\t\t\tnumber the nodes in topological order\n"
+                "  -c\t\t\tsolve the independent components separately\n"
+                "  -w\t\t\tuse real weights\n"
+                "  -W FILE\t\tuse the weights in FILE, can be repeated\n"
+                "  -a\t\t\tsolve one candidate per orbit of the "
+                "automorphism group\n"
+                "  -b\t\t\twrite the subgraphs in binary format\n"
+                "  -B\t\t\tsame as -b, with inputs and outputs\n"
+                "  --checkpoint FILE\tsave the state of the search to FILE\n"
+                "  --checkpoint-interval S\n"
+                "  \t\t\tsave the state every S seconds (default 60)\n"
+                "  --resume FILE\t\tcontinue the search saved in FILE\n");
+        return 1;
+    }
+    if (split && (!checkpoint.empty() || !resume.empty())) {
+        fprintf(stderr, "checkpoints are not supported with -c\n");
+        return 1;
+    }
+    if (!weight_files.empty() &&
+        (split || reduce || renumber || binary || !checkpoint.empty() ||
+         !resume.empty())) {
+        fprintf(stderr,
+                "-W is not supported with -b, -c, -n, -r and checkpoints\n");
         return 1;
     }
 
@@ -110,9 +174,79 @@ int main(int argc, char *argv[])
     if (dfg->forbidden().size() == dfg->num_nodes())
         return 1;
 
+    if (!weight_files.empty()) {
+        // the candidates are computed once for all the weight files
+        auto start = std::chrono::steady_clock::now();
+        MVSFinder finder(*dfg);
+        finder.set_automorphisms(automorphisms);
+        auto reports = nlohmann::json::array();
+        for (auto &file : weight_files) {
+            std::ifstream in(file);
+            try {
+                if (!in)
+                    throw std::runtime_error("cannot open " + file);
+                dfg->read_weights(in);
+            } catch (const std::exception &e) {
+                fprintf(stderr, "%s\n", e.what());
+                return 1;
+            }
+            finder.reweight();
+            auto output =
+                finder.enumerate(max_num_in, max_num_out, itype, flags);
+            const auto end = std::chrono::steady_clock::now();
+            const std::chrono::duration<double> elapsed = end - start;
+            start = end;
+            reports.push_back({
+                {"max_weight", !output.empty() ? output[0].weight() : 0},
+                {"name", dfg->name()},
+                {"num_nodes", dfg->num_nodes()},
+                {"num_subgraphs", output.size()},
+                {"subgraphs", output},
+                {"time", elapsed.count()},
+                {"weights", file},
+            });
+        }
+        std::cout << reports.dump(4) << std::endl;
+        return 0;
+    }
+
     const auto start = std::chrono::steady_clock::now();
-    MVSFinder finder(dfg.get());
-    auto output = finder.enumerate(max_num_in, max_num_out, itype, flags);
+    std::unique_ptr<MappedDFG> reduced;
+    if (reduce) {
+        reduced = MappedDFG::reduce(*dfg);
+        nlohmann::json json = {
+            {"reduced_nodes", reduced->dfg().num_nodes()},
+        };
+        std::cerr << json.dump() << std::endl;
+    }
+    std::unique_ptr<MappedDFG> renumbered;
+    if (renumber)
+        renumbered = MappedDFG::renumber(reduced ? reduced->dfg() : *dfg);
+    const DFG &graph = renumbered ? renumbered->dfg()
+                       : reduced  ? reduced->dfg()
+                                  : *dfg;
+    std::vector<IOSubgraph> output;
+    if (split) {
+        SplitFinder finder(graph, std::thread::hardware_concurrency());
+        output = finder.enumerate(max_num_in, max_num_out, itype, flags);
+    } else {
+        MVSFinder finder(graph);
+        if (!checkpoint.empty())
+            finder.set_checkpoint(checkpoint, checkpoint_interval);
+        finder.set_automorphisms(automorphisms);
+        try {
+            if (!resume.empty())
+                finder.resume(resume);
+            output = finder.enumerate(max_num_in, max_num_out, itype, flags);
+        } catch (const std::exception &e) {
+            fprintf(stderr, "%s\n", e.what());
+            return 1;
+        }
+    }
+    if (renumbered)
+        output = renumbered->expand(output);
+    if (reduced)
+        output = reduced->expand(output);
     const auto end = std::chrono::steady_clock::now();
     const std::chrono::duration<double> elapsed = end - start;
 
@@ -121,10 +255,17 @@ int main(int argc, char *argv[])
         {"name", dfg->name()},
         {"num_nodes", dfg->num_nodes()},
         {"num_subgraphs", output.size()},
-        {"subgraphs", output},
         {"time", elapsed.count()},
     };
-    std::cout << report.dump(4) << std::endl;
+    if (binary) {
+        ResultWriter writer(std::cout, dfg->num_nodes(), binary_io);
+        for (auto &subgraph : output)
+            writer.write(subgraph);
+        writer.finish(report);
+    } else {
+        report["subgraphs"] = output;
+        std::cout << report.dump(4) << std::endl;
+    }
 
     return 0;
 }
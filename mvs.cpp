@@ -14,24 +14,69 @@
    along with this program; if not, see <http://www.gnu.org/licenses/>.  */
 
 #include "mvs.h"
+#include "automorphism.h"
 #include "cluster.h"
 #include "common.h"
 #include "dfg.h"
 #include "graph.h"
 #include "intset.h"
+#include "intset_stats.h"
 #include "io.h"
 #include "nlohmann/json.hpp"
 #include "vset.h"
 #include <algorithm>
 #include <cassert>
+#include <climits>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+bool parse_flags(const std::string &str, uint8_t &flags)
+{
+    flags = 0xff;
+    for (auto &field : split(str, ',')) {
+        int v;
+        if (!parse_integer(field, v, 1, 7))
+            return false;
+        flags &= ~(uint8_t(1) << v);
+    }
+    return true;
+}
+
+bool parse_itype(const std::string &str, MVSFinder::IterType &itype)
+{
+    if (str == "linear")
+        itype = MVSFinder::IterType::LINEAR;
+    else if (str == "linear-rev")
+        itype = MVSFinder::IterType::LINEAR_REV;
+    else if (str == "binary-search")
+        itype = MVSFinder::IterType::BINARY_SEARCH;
+    else
+        return false;
+    return true;
+}
+
+// the nodes v such that no forbidden node is on a path between u and v
+static void p_set(const DFG &dfg, int u, intset &P)
+{
+    const intset &F = dfg.forbidden();
+    for (int v = 0; v < dfg.num_nodes(); v++) {
+        if (!F.contains(v) && !F.intersects(dfg.pred(u), dfg.succ(v)) &&
+            !F.intersects(dfg.succ(u), dfg.pred(v)))
+            P.add(v);
+    }
+}
+
 static bool is_source(const DFG &dfg, const intset &config, int u)
 {
     for (auto &v : dfg.in_edges(u)) {
@@ -58,8 +103,8 @@ int MVSFinder::find_best_recursion_node(int max_num_in,
     int id = -1;
     std::pair<int, int> best_delta(0, 0);
     for (const auto &u : nodes_left_) {
-        bool source = is_source(*dfg_, nodes(), u);
-        bool sink = is_sink(*dfg_, nodes(), u);
+        bool source = is_source(view_, nodes(), u);
+        bool sink = is_sink(view_, nodes(), u);
 
         if (source || sink) {
             nodes_left_.remove(u);
@@ -95,16 +140,115 @@ static double sum_smallest(vmap<int, double> &map, int n)
     return sum;
 }
 
-void MVSFinder::visit(double dels,
-                      bool single,
-                      int &max_weight,
-                      int max_num_in,
-                      int max_num_out)
+// the weight of a subgraph of candidate that satisfies the constraints,
+// found by removing the sources and sinks that reduce the excess of
+// inputs and outputs the most per unit of weight, and then adding back
+// the heaviest nodes that keep the subgraph convex and within the
+// constraints
+static int greedy_io_weight(const IOSubgraph &candidate,
+                            int max_num_in,
+                            int max_num_out)
+{
+    auto &dfg = candidate.dfg();
+    auto excess = [max_num_in, max_num_out](const IOSubgraph &s) {
+        return std::max(s.num_in() - max_num_in, 0) +
+               std::max(s.num_out() - max_num_out, 0);
+    };
+    IOSubgraph config(candidate);
+    std::vector<int> removed;
+    while (excess(config) > 0) {
+        int best = -1;
+        double best_ratio = 0;
+        int e = excess(config);
+        for (auto u : config.nodes()) {
+            if (!is_source(dfg, config.nodes(), u) &&
+                !is_sink(dfg, config.nodes(), u))
+                continue;
+            config.remove(u);
+            double gain = e - excess(config);
+            config.add(u);
+            double ratio = gain / std::max(dfg.weight(u), 1e-9);
+            if (best == -1 || ratio > best_ratio ||
+                (ratio == best_ratio && dfg.weight(u) < dfg.weight(best))) {
+                best = u;
+                best_ratio = ratio;
+            }
+        }
+        config.remove(best);
+        removed.push_back(best);
+    }
+
+    std::sort(removed.begin(), removed.end(), [&dfg](int u, int v) {
+        return dfg.weight(u) > dfg.weight(v);
+    });
+    bool improved = true;
+    while (improved) {
+        improved = false;
+        intset pred = config.pred();
+        intset succ = config.succ();
+        for (auto &u : removed) {
+            // a path through u between two nodes of config stays in
+            // the candidate, which is convex
+            if (u == -1 ||
+                (dfg.succ(u) & pred).intersects(candidate.nodes()) ||
+                (dfg.pred(u) & succ).intersects(candidate.nodes()))
+                continue;
+            config.add(u);
+            if (excess(config) == 0) {
+                u = -1;
+                improved = true;
+                break;
+            }
+            config.remove(u);
+        }
+    }
+    return config.weight();
+}
+
+// an upper bound on the weight of the subgraphs of candidate that
+// satisfy the constraints, from the deletions required by the pruning
+// criteria at the root of the search
+static double weight_bound(const IOSubgraph &candidate,
+                           int max_num_in,
+                           int max_num_out)
+{
+    IOAnalysis analysis(candidate, candidate.nodes());
+    int required_dels_in = 0;
+    int required_dels_out = 0;
+    if (candidate.num_in() > max_num_in) {
+        if (analysis.num_perm_in() > max_num_in)
+            return -1;
+        required_dels_in = ceil(sum_smallest(analysis.get_inputs(),
+                                             candidate.num_in() - max_num_in));
+    }
+    if (candidate.num_out() > max_num_out) {
+        if (analysis.num_perm_out() > max_num_out)
+            return -1;
+        required_dels_out = candidate.num_out() - max_num_out;
+    }
+    int num_shared_non_perm_out = std::min({
+        analysis.num_shared_non_perm_out(),
+        required_dels_in,
+        required_dels_out,
+    });
+    return ceil(candidate.weight()) -
+           sum_smallest(analysis.get_rnodes(),
+                        required_dels_in + required_dels_out -
+                            num_shared_non_perm_out);
+}
+
+// visit a node of the search tree, and return the node to remove in
+// the first child or -1 if it is a leaf
+int MVSFinder::enter(double dels,
+                     bool single,
+                     int &max_weight,
+                     int max_num_in,
+                     int max_num_out)
 {
     calls_++;
 
     if (dels < 0 || (count_ && single))
-        return;
+        return -1;
 
     if (config_.num_in() <= max_num_in && config_.num_out() <= max_num_out) {
         double weight = config_.weight();
@@ -132,7 +276,7 @@ void MVSFinder::visit(double dels,
             cluster.contract(config_);
         for (auto &cluster : s_nodes_)
             cluster.contract(config_);
-        return;
+        return -1;
     }
 
     // pruning
@@ -179,25 +323,218 @@ void MVSFinder::visit(double dels,
         prune = true;
     }
 
+    // the paths to and from the permanent nodes
+    if ((flags_ & (1 << 6)) && !prune &&
+        flow_.exceeds(config_, nodes_left_, max_num_in, max_num_out, dels)) {
+        pruned_[3]++;
+        prune = true;
+    }
+
     if (prune)
-        return;
+        return -1;
 
-    int id = find_best_recursion_node(max_num_in,
-                                      max_num_out,
-                                      analysis.num_perm_in(),
-                                      analysis.num_perm_out());
-    if (id == -1)
+    return find_best_recursion_node(max_num_in,
+                                    max_num_out,
+                                    analysis.num_perm_in(),
+                                    analysis.num_perm_out());
+}
+
+// depth-first search of the subgraphs of config_ with an explicit
+// stack: the first child of a node removes a node from config_, the
+// second child keeps it
+void MVSFinder::visit(double dels,
+                      bool single,
+                      int &max_weight,
+                      int max_num_in,
+                      int max_num_out)
+{
+    size_t first = io_output_->size();
+    size_t k = visits_.size();
+    if (k < replay_.size()) {
+        restore_visit(replay_[k], dels, max_weight);
+        visits_.push_back(replay_[k]);
         return;
+    }
+
+    stack_.clear();
+    if (k == replay_.size() && !replay_stack_.empty()) {
+        restore_visit(replay_current_, dels, max_weight);
+        stack_ = replay_stack_;
+        replay_stack_.clear();
+        for (auto &frame : stack_) {
+            if (frame.state != Frame::ENTER)
+                nodes_left_.remove(frame.id);
+            if (frame.state == Frame::FIRST)
+                config_.remove(frame.id);
+        }
+    } else
+        stack_.push_back({Frame::ENTER, -1, dels});
+
+    const std::chrono::duration<double> interval(checkpoint_interval_);
+    unsigned ticks = 0;
+    while (!stack_.empty()) {
+        if (!checkpoint_path_.empty() && ++ticks % 256 == 0 &&
+            std::chrono::steady_clock::now() - last_checkpoint_ >= interval)
+            save_checkpoint(dels, max_weight, first);
 
-    nodes_left_.remove(id);
+        Frame &frame = stack_.back();
+        double child_dels = frame.dels;
+        switch (frame.state) {
+            case Frame::ENTER:
+                frame.id = enter(
+                    frame.dels, single, max_weight, max_num_in, max_num_out);
+                if (frame.id == -1) {
+                    stack_.pop_back();
+                    break;
+                }
+                nodes_left_.remove(frame.id);
+                config_.remove(frame.id);
+                frame.state = Frame::FIRST;
+                child_dels -= view_.weight(frame.id);
+                stack_.push_back({Frame::ENTER, -1, child_dels});
+                break;
+            case Frame::FIRST:
+                config_.add(frame.id);
+                frame.state = Frame::SECOND;
+                stack_.push_back({Frame::ENTER, -1, child_dels});
+                break;
+            case Frame::SECOND:
+                nodes_left_.add(frame.id);
+                stack_.pop_back();
+                break;
+        }
+    }
+    visits_.push_back(make_visit(dels, max_weight, first));
+}
 
-    config_.remove(id);
-    visit(dels - dfg_->weight(id), single, max_weight, max_num_in, max_num_out);
+// the outcome of the current call to visit, whose subgraphs start at
+// position 'first' of the output
+MVSFinder::Visit
+MVSFinder::make_visit(double dels, int max_weight, size_t first) const
+{
+    Visit visit {dels, max_weight, count_, calls_, {}, {}};
+    std::copy(pruned_, pruned_ + 4, visit.pruned);
+    for (size_t i = first; i < io_output_->size(); i++)
+        visit.subgraphs.push_back((*io_output_)[i].nodes());
+    return visit;
+}
 
-    config_.add(id);
-    visit(dels, single, max_weight, max_num_in, max_num_out);
+void MVSFinder::restore_visit(const Visit &visit, double dels, int &max_weight)
+{
+    if (visit.dels != dels)
+        throw std::runtime_error("checkpoint does not match the search");
+    max_weight = visit.max_weight;
+    count_ = visit.count;
+    calls_ = visit.calls;
+    std::copy(visit.pruned, visit.pruned + 4, pruned_);
+    for (auto &nodes : visit.subgraphs)
+        io_output_->emplace_back(view_, intset(nodes));
+}
 
-    nodes_left_.add(id);
+static nlohmann::json visit_json(double dels,
+                                 int max_weight,
+                                 unsigned count,
+                                 unsigned calls,
+                                 const unsigned *pruned,
+                                 const std::vector<intset> &subgraphs)
+{
+    return {
+        {"dels", dels},
+        {"max_weight", max_weight},
+        {"count", count},
+        {"calls", calls},
+        {"pruned", {pruned[0], pruned[1], pruned[2], pruned[3]}},
+        {"subgraphs", subgraphs},
+    };
+}
+
+// write to a temporary file first, so that an interrupted write leaves
+// the previous checkpoint intact
+static void write_file(const std::string &path, const std::string &data)
+{
+    std::string tmp = path + ".tmp";
+    std::ofstream out(tmp);
+    out << data << std::endl;
+    out.close();
+    if (out.fail() || std::rename(tmp.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("cannot write " + path);
+}
+
+void MVSFinder::save_checkpoint(double dels, int max_weight, size_t first)
+{
+    nlohmann::json visits = nlohmann::json::array();
+    for (auto &v : visits_)
+        visits += visit_json(
+            v.dels, v.max_weight, v.count, v.calls, v.pruned, v.subgraphs);
+
+    auto current = make_visit(dels, max_weight, first);
+    nlohmann::json stack = nlohmann::json::array();
+    for (auto &frame : stack_)
+        stack.push_back({int(frame.state), frame.id, frame.dels});
+
+    nlohmann::json json = {
+        {"search", search_},
+        {"visits", visits},
+        {"current",
+         visit_json(current.dels,
+                    current.max_weight,
+                    current.count,
+                    current.calls,
+                    current.pruned,
+                    current.subgraphs)},
+        {"stack", stack},
+    };
+    write_file(checkpoint_path_, json.dump());
+    last_checkpoint_ = std::chrono::steady_clock::now();
+}
+
+void MVSFinder::set_checkpoint(const std::string &path, double interval)
+{
+    checkpoint_path_ = path;
+    checkpoint_interval_ = interval;
+    last_checkpoint_ = std::chrono::steady_clock::now();
+}
+
+void MVSFinder::resume(const std::string &path)
+{
+    std::ifstream in(path);
+    if (!in)
+        throw std::runtime_error("cannot read " + path);
+    auto json = nlohmann::json::parse(in);
+    auto read_visit = [this](const nlohmann::json &json) {
+        Visit visit {
+            json.at("dels").get<double>(),
+            json.at("max_weight").get<int>(),
+            json.at("count").get<unsigned>(),
+            json.at("calls").get<unsigned>(),
+            {},
+            {},
+        };
+        for (int i = 0; i < 4; i++)
+            visit.pruned[i] = json.at("pruned").at(i).get<unsigned>();
+        for (auto &nodes : json.at("subgraphs")) {
+            visit.subgraphs.emplace_back(view_.num_nodes());
+            for (auto &u : nodes)
+                visit.subgraphs.back().add(u.get<int>());
+        }
+        return visit;
+    };
+
+    resume_ = json.at("search");
+    replay_.clear();
+    for (auto &visit : json.at("visits"))
+        replay_.push_back(read_visit(visit));
+    replay_current_ = read_visit(json.at("current"));
+    replay_stack_.clear();
+    for (auto &frame : json.at("stack")) {
+        int state = frame.at(0).get<int>();
+        int id = frame.at(1).get<int>();
+        if (state < Frame::ENTER || state > Frame::SECOND || id < -1 ||
+            id >= view_.num_nodes())
+            throw std::runtime_error("invalid checkpoint");
+        replay_stack_.push_back(
+            {Frame::State(state), id, frame.at(2).get<double>()});
+    }
 }
 
 int MVSFinder::find_mvsio_(mvs &mvs,
@@ -219,7 +556,7 @@ int MVSFinder::find_mvsio_(mvs &mvs,
         {"num_outputs", max_num_out},
         {"num_s-nodes", s_nodes_.size()},
     };
-    std::cerr << json.dump() << std::endl;
+    log_json(json);
     if (single) {
         int io_weight = 0;
         switch (itype_) {
@@ -288,8 +625,8 @@ void MVSFinder::find_mvsio(mvs &mvs,
         s_nodes_ = snode_enumerate(mvs, s_clusters_);
         for (auto &cluster : s_nodes_) {
             link_cluster(cluster);
-            s_weights.push_back(dfg_->weight(cluster.nodes().front().first));
-            if (dfg_->out_edges(cluster.src()).size() > 1)
+            s_weights.push_back(cluster.nodes().front().second);
+            if (view_.out_edges(cluster.src()).size() > 1)
                 s_node_input_delta = 0;
         }
         std::sort(s_weights.begin(), s_weights.end(), std::greater<>());
@@ -345,6 +682,7 @@ std::vector<IOSubgraph> MVSFinder::enumerate(int max_num_in,
                                              IterType itype,
                                              uint8_t flags)
 {
+    INTSET_PHASE("search");
     itype_ = itype;
     flags_ = flags;
     nlohmann::json json = {
@@ -352,45 +690,168 @@ std::vector<IOSubgraph> MVSFinder::enumerate(int max_num_in,
         {"num_outputs", max_num_out},
         {"flags", flags_},
     };
-    std::cerr << json.dump() << std::endl;
+    log_json(json);
+
+    search_ = {
+        {"name", dfg_->name()},
+        {"num_nodes", dfg_->num_nodes()},
+        {"num_inputs", max_num_in},
+        {"num_outputs", max_num_out},
+        {"flags", flags_},
+        {"iteration", int(itype_)},
+        {"automorphisms", automorphisms_},
+    };
+    if (!resume_.is_null() && resume_ != search_)
+        throw std::runtime_error("checkpoint does not match the search");
+    visits_.clear();
+
+    // forget the results of a previous call with another search. The
+    // visits of a checkpoint are those of a search from scratch.
+    if (search_ != last_search_ || !checkpoint_path_.empty() ||
+        !resume_.is_null()) {
+        for (auto &result : results_)
+            result = {};
+    }
+    last_search_ = nullptr;
+
+    // the candidates are the same up to the automorphisms of the graph,
+    // so that each orbit is solved by its first candidate
+    std::vector<unsigned> orbit(num_candidates());
+    std::vector<Automorphisms::Permutation> orbit_map(num_candidates());
+    for (unsigned i = 0; i < num_candidates(); i++)
+        orbit[i] = i;
+    if (automorphisms_)
+        find_orbits(orbit, orbit_map);
 
     std::vector<IOSubgraph> output;
     io_output_ = &output;
     int max_io_weight = 0;
-    for (auto &mvsc : mvs_vec_) {
+    for (auto &result : results_)
+        if (result.io_weight >= result.min_io_weight)
+            max_io_weight = std::max(max_io_weight, result.io_weight);
+    // heuristic subgraphs of the heaviest candidates bound the weight
+    // from below before the exact search. The search of the lighter
+    // ones starts from the bound of the heavier ones anyway.
+    if (flags_ & (1 << 7)) {
+        unsigned n = 0;
+        for (unsigned i = 0; i < num_candidates() && n < 16; i++) {
+            if (orbit[i] != i || candidate_weights_[i] <= max_io_weight)
+                continue;
+            n++;
+            max_io_weight = std::max(
+                max_io_weight,
+                greedy_io_weight(candidate(i), max_num_in, max_num_out));
+        }
+        nlohmann::json json = {
+            {"warm_start", max_io_weight},
+        };
+        log_json(json);
+    }
+    // the candidates are solved in decreasing order of a bound on their
+    // weight, the candidates of an orbit after the first one, until the
+    // bound is below the weight found
+    std::vector<double> bound(num_candidates());
+    for (unsigned i = 0; i < num_candidates(); i++)
+        bound[i] = orbit[i] == i ? weight_bound(
+                                       candidate(i), max_num_in, max_num_out)
+                                 : bound[orbit[i]];
+    std::vector<unsigned> order(num_candidates());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&bound](int i, int j) {
+        return bound[i] > bound[j];
+    });
+    for (unsigned k = 0; k < order.size(); k++) {
+        unsigned i = order[k];
+        if ((flags_ & (1 << 3)) && bound[i] < max_io_weight) {
+            nlohmann::json json = {
+                {"skipped", order.size() - k},
+            };
+            log_json(json);
+            break;
+        }
+        auto mvsc = candidate(i);
         nlohmann::json json = {
             {"enum", false},
             {"max_io_weight", max_io_weight},
             {"mvs", mvsc},
         };
-        std::cerr << json.dump() << std::endl;
+        log_json(json);
+
+        if (orbit[i] != i) {
+            // the threshold of the first candidate is not larger, so
+            // its weight is either the same or below max_io_weight
+            results_[i] = results_[orbit[i]];
+            json = {
+                {"io_weight", results_[i].io_weight},
+                {"orbit", orbit[i]},
+            };
+            log_json(json);
+            continue;
+        }
 
         int m = flags_ & (1 << 5) ? max_io_weight : 0;
-        if (mvsc.weight() >= m) {
-            if (mvsc.num_in() > max_num_in || mvsc.num_out() > max_num_out)
+        bool known = mvsc.io_weight >= mvsc.min_io_weight ||
+                     mvsc.min_io_weight <= m;
+        if (!known && mvsc.weight() >= m) {
+            if (mvsc.num_in() > max_num_in || mvsc.num_out() > max_num_out) {
                 find_mvsio(mvsc, true, m, max_num_in, max_num_out);
-            else
+                mvsc.min_io_weight = m;
+            } else {
                 mvsc.io_weight = mvsc.weight();
+                mvsc.min_io_weight = 0;
+            }
             max_io_weight = std::max(max_io_weight, mvsc.io_weight);
         }
+        results_[i] = mvsc;
         json = {
             {"io_weight", mvsc.io_weight},
+            {"reused", known},
         };
-        std::cerr << json.dump() << std::endl;
+        log_json(json);
     }
 
-    for (auto &mvsc : mvs_vec_) {
-        if (mvsc.io_weight == max_io_weight) {
+    auto add = [&output](IOSubgraph &&subgraph) {
+        if (std::find_if(output.begin(),
+                         output.end(),
+                         [&subgraph](const IOSubgraph &mvs) {
+                             return mvs.nodes() == subgraph.nodes();
+                         }) == output.end())
+            output.push_back(std::move(subgraph));
+    };
+    // the subgraphs of the first candidate of each orbit, including
+    // those already found from another candidate
+    std::vector<std::vector<intset>> orbit_output(num_candidates());
+    for (unsigned i = 0; i < num_candidates(); i++) {
+        if (results_[i].io_weight == max_io_weight) {
+            auto mvsc = candidate(i);
             nlohmann::json json = {
                 {"enum", true},
                 {"max_io_weight", max_io_weight},
                 {"mvs", mvsc},
             };
-            std::cerr << json.dump() << std::endl;
-            if (mvsc.io_weight < mvsc.weight())
+            log_json(json);
+            if (orbit[i] != i) {
+                for (auto &nodes : orbit_output[orbit[i]])
+                    add(IOSubgraph(
+                        view_, Automorphisms::apply(orbit_map[i], nodes)));
+            } else if (automorphisms_) {
+                std::vector<IOSubgraph> found;
+                io_output_ = &found;
+                if (mvsc.io_weight < mvsc.weight())
+                    find_mvsio(
+                        mvsc, false, max_io_weight, max_num_in, max_num_out);
+                else
+                    found.emplace_back(mvsc);
+                io_output_ = &output;
+                for (auto &subgraph : found) {
+                    orbit_output[i].push_back(subgraph.nodes());
+                    add(std::move(subgraph));
+                }
+            } else if (mvsc.io_weight < mvsc.weight()) {
                 find_mvsio(mvsc, false, max_io_weight, max_num_in, max_num_out);
-            else
+            } else {
                 io_output_->emplace_back(mvsc);
+            }
         }
     }
 
@@ -399,48 +860,113 @@ std::vector<IOSubgraph> MVSFinder::enumerate(int max_num_in,
         if (mvs.weight() > max_weight && !fp_eq(mvs.weight(), max_weight, 0.01))
             max_weight = mvs.weight();
 
-    for (auto it = output.begin(); it != output.end();)
-        if (max_weight > (*it).weight() &&
-            !fp_eq((*it).weight(), max_weight, 0.01))
-            it = output.erase(it);
-        else
-            it++;
-    return output;
+    // the subgraphs refer to the graph passed to the constructor, not
+    // to the private view
+    std::vector<IOSubgraph> result;
+    for (auto &mvs : output)
+        if (max_weight <= mvs.weight() || fp_eq(mvs.weight(), max_weight, 0.01))
+            result.emplace_back(*dfg_, intset(mvs.nodes()));
+
+    last_search_ = search_;
+    // a resumed search continues only once
+    resume_ = nullptr;
+    replay_.clear();
+    replay_stack_.clear();
+    return result;
+}
+
+void MVSFinder::find_orbits(std::vector<unsigned> &orbit,
+                            std::vector<Automorphisms::Permutation> &map)
+{
+    Automorphisms automorphisms(*dfg_);
+    std::unordered_multimap<size_t, unsigned> index;
+    for (unsigned i = 0; i < num_candidates(); i++)
+        index.emplace(candidate_nodes(i).hash(), i);
+
+    unsigned num_orbits = 0;
+    for (unsigned i = 0; i < num_candidates(); i++) {
+        if (orbit[i] != i)
+            continue;
+        num_orbits++;
+        for (auto &image : automorphisms.orbit(candidate_nodes(i))) {
+            auto range = index.equal_range(image.first.hash());
+            for (auto it = range.first; it != range.second; ++it) {
+                unsigned j = it->second;
+                if (j > i && orbit[j] == j &&
+                    candidate_nodes(j) == image.first) {
+                    orbit[j] = i;
+                    map[j] = std::move(image.second);
+                }
+            }
+        }
+    }
+
+    nlohmann::json json = {
+        {"num_generators", automorphisms.generators().size()},
+        {"num_orbits", num_orbits},
+    };
+    log_json(json);
 }
 
 void MVSFinder::link_cluster(const SCluster &cluster)
 {
     for (auto &edge : cluster.edges())
-        dfg_->remove_edge(edge.first, edge.second);
-    dfg_->add_edge(cluster.src(), cluster.dst());
+        view_.remove_edge(edge.first, edge.second);
+    view_.add_edge(cluster.src(), cluster.dst());
     for (auto &node : cluster.nodes()) {
         clustered_.add(node.first);
-        dfg_->weight(cluster.dst()) += node.second;
-        dfg_->weight(node.first) = 0;
+        view_.weight(cluster.dst()) += node.second;
+        view_.weight(node.first) = 0;
     }
 }
 
 void MVSFinder::unlink_cluster(const SCluster &cluster)
 {
-    dfg_->remove_edge(cluster.src(), cluster.dst());
+    view_.remove_edge(cluster.src(), cluster.dst());
     for (auto &edge : cluster.edges())
-        dfg_->add_edge(edge.first, edge.second);
+        view_.add_edge(edge.first, edge.second);
     for (auto &node : cluster.nodes()) {
         clustered_.remove(node.first);
-        dfg_->weight(cluster.dst()) -= node.second;
-        dfg_->weight(node.first) = node.second;
+        view_.weight(cluster.dst()) -= node.second;
+        view_.weight(node.first) = node.second;
     }
 }
 
+size_t MVSFinder::memory_size() const
+{
+    size_t size = sizeof(*this);
+    auto set_size = (dfg_->num_nodes() + 63) / 64 * sizeof(unsigned long);
+    for (int i = 0; i < view_.num_nodes(); i++)
+        size += (view_.in_edges(i).capacity() +
+                 view_.out_edges(i).capacity()) *
+                sizeof(int);
+    for (auto &cluster : v_clusters_)
+        size += sizeof(cluster) + set_size +
+                cluster.nodes.capacity() * sizeof(int);
+    for (auto *clusters : {&s_clusters_, &s_nodes_})
+        for (auto &cluster : *clusters)
+            size += sizeof(cluster) +
+                    cluster.nodes().capacity() *
+                        sizeof(std::pair<int, double>) +
+                    cluster.edges().capacity() * sizeof(std::pair<int, int>);
+    size += candidate_blocks_.capacity() * sizeof(intset::block) +
+            candidate_weights_.capacity() * sizeof(double) +
+            results_.capacity() * sizeof(MVSResult);
+    size += stack_.capacity() * sizeof(Frame);
+    return size;
+}
+
 static void dump_v_graph(const Graph &v_graph,
                          const std::vector<VCluster> &v_clusters)
 {
     nlohmann::json json = nlohmann::json::array();
     for (unsigned i = 0; i < v_clusters.size(); i++) {
+        std::vector<int> edges;
+        v_graph.for_each_edge(i, [&edges](int v) { edges.push_back(v); });
         json += {
             {"id", i},
             {"nodes", v_clusters[i].nodes},
-            {"edges", v_graph.edges(i)},
+            {"edges", edges},
         };
     };
     std::cerr << json.dump() << std::endl;
@@ -452,47 +978,62 @@ static void dump_s_clusters(const std::vector<SCluster> &s_clusters)
     std::cerr << json.dump() << std::endl;
 }
 
-MVSFinder::MVSFinder(DFG *dfg)
-    : dfg_(dfg)
-    , config_(*dfg)
-    , nodes_left_(dfg->num_nodes())
-    , clustered_(dfg->num_nodes())
+MVSFinder::MVSFinder(const DFG &dfg, std::ostream *log)
+    : dfg_(&dfg)
+    , view_(dfg)
+    , config_(view_)
+    , nodes_left_(dfg.num_nodes())
+    , clustered_(dfg.num_nodes())
+    , flow_(dfg.num_nodes())
+    , log_(log)
 {
+    INTSET_PHASE("candidates");
+
+    // each level of the search removes a node from nodes_left_
+    stack_.reserve(dfg.num_nodes() + 1);
+
     // compute P sets and equivalence classes
-    auto class_of = std::make_unique<int[]>(dfg->num_nodes());
-    intset P(dfg->num_nodes());
-    intset F = dfg->forbidden();
-    for (int u = 0; u < dfg->num_nodes(); u++) {
-        if (F.contains(u))
+    intset P(dfg.num_nodes());
+    for (int u = 0; u < dfg.num_nodes(); u++) {
+        if (dfg.forbidden().contains(u))
             continue;
-        for (int v = 0; v < dfg->num_nodes(); v++) {
-            // check if v is in P(u)
-            if (!F.contains(v) && !F.intersects(dfg->pred(u), dfg->succ(v)) &&
-                !F.intersects(dfg->succ(u), dfg->pred(v)))
-                P.add(v);
-        }
+        p_set(dfg, u, P);
+        add_to_class(u, P);
+        P.clear();
+    }
 
-        // check if node u belongs to a previously computed equivalence class
-        int class_id = -1;
-        for (int i = 0; i < v_clusters_.size(); i++) {
-            if (P == v_clusters_[i].P()) {
-                class_id = i;
-                break;
-            }
-        }
+    find_candidates();
+}
 
-        if (class_id == -1) {
-            class_id = v_clusters_.size();
-            v_clusters_.emplace_back(P);
+// add u to the equivalence class with P set P, or to a new class
+void MVSFinder::add_to_class(int u, const intset &P)
+{
+    int class_id = -1;
+    for (int i = 0; i < v_clusters_.size(); i++) {
+        if (P == v_clusters_[i].P()) {
+            class_id = i;
+            break;
         }
-        P.clear();
-        v_clusters_[class_id].nodes.push_back(u);
-        class_of[u] = class_id;
     }
 
-    // build adjacency lists of clusters in the cluster graph
+    if (class_id == -1) {
+        class_id = v_clusters_.size();
+        v_clusters_.emplace_back(P);
+    }
+    v_clusters_[class_id].nodes.push_back(u);
+}
+
+void MVSFinder::find_candidates()
+{
+    auto class_of = std::make_unique<int[]>(dfg_->num_nodes());
+    for (int i = 0; i < v_clusters_.size(); i++)
+        for (auto u : v_clusters_[i].nodes)
+            class_of[u] = i;
+
+    // build the adjacency matrix of the cluster graph, its complement
+    // is dense
     int num_clusters = v_clusters_.size();
-    Graph v_graph(num_clusters);
+    Graph v_graph(num_clusters, true);
 
     for (int i = 0; i < num_clusters; i++) {
         for (const auto &v : v_clusters_[i].P()) {
@@ -503,17 +1044,29 @@ MVSFinder::MVSFinder(DFG *dfg)
 
     v_graph.invert();
 
-    MISFinder finder(
-        &v_graph,
-        [this](const intset &) { mvs_vec_.emplace_back(config_); },
-        [this](const intset &, int id, bool add) {
-            for (auto v : v_clusters_[id].nodes) {
-                if (add)
-                    config_.add(v);
-                else
-                    config_.remove(v);
+    candidate_blocks_.clear();
+    candidate_weights_.clear();
+    results_.clear();
+    // the inputs and outputs of a candidate are computed when the
+    // search reaches it
+    intset nodes(dfg_->num_nodes());
+    double weight = 0;
+    auto output_cb = [this, &nodes, &weight](const intset &) {
+        add_candidate(nodes, weight);
+    };
+    auto update_cb = [this, &nodes, &weight](const intset &, int id, bool add) {
+        for (auto v : v_clusters_[id].nodes) {
+            if (add) {
+                nodes.add(v);
+                weight += view_.weight(v);
+            } else {
+                nodes.remove(v);
+                weight -= view_.weight(v);
             }
-        });
+        }
+    };
+    BasicMISFinder<decltype(output_cb), decltype(update_cb)> finder(
+        &v_graph, output_cb, update_cb);
 
     s_clusters_ = scluster_enumerate(*dfg_);
 
@@ -527,11 +1080,157 @@ MVSFinder::MVSFinder(DFG *dfg)
         {"num_mvs-c", finder.get_count()},
         {"num_s-cluster-nodes", n},
     };
-    std::cerr << json.dump() << std::endl;
+    log_json(json);
 
-    std::sort(mvs_vec_.begin(),
-              mvs_vec_.end(),
-              [](const IOSubgraph &i1, const IOSubgraph &i2) {
-                  return i1.weight() > i2.weight();
-              });
+    sort_candidates();
+}
+
+intset MVSFinder::candidate_nodes(unsigned i) const
+{
+    intset nodes(dfg_->num_nodes());
+    std::copy_n(&candidate_blocks_[i * nodes.num_blocks()],
+                nodes.num_blocks(),
+                nodes.data());
+    return nodes;
+}
+
+mvs MVSFinder::candidate(unsigned i) const
+{
+    return mvs(IOSubgraph(view_, candidate_nodes(i)), results_[i]);
+}
+
+void MVSFinder::add_candidate(const intset &nodes, double weight)
+{
+    candidate_blocks_.insert(candidate_blocks_.end(),
+                             nodes.data(),
+                             nodes.data() + nodes.num_blocks());
+    candidate_weights_.push_back(weight);
+    results_.emplace_back();
+}
+
+// sort the candidates by decreasing weight
+void MVSFinder::sort_candidates()
+{
+    std::vector<unsigned> order(num_candidates());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](int i, int j) {
+        return candidate_weights_[i] > candidate_weights_[j];
+    });
+    unsigned num_blocks = intset(dfg_->num_nodes()).num_blocks();
+    std::vector<intset::block> blocks;
+    std::vector<double> weights;
+    std::vector<MVSResult> results;
+    blocks.reserve(candidate_blocks_.size());
+    for (auto i : order) {
+        blocks.insert(blocks.end(),
+                      &candidate_blocks_[i * num_blocks],
+                      &candidate_blocks_[(i + 1) * num_blocks]);
+        weights.push_back(candidate_weights_[i]);
+        results.push_back(results_[i]);
+    }
+    candidate_blocks_ = std::move(blocks);
+    candidate_weights_ = std::move(weights);
+    results_ = std::move(results);
+}
+
+void MVSFinder::reweight()
+{
+    for (int u = 0; u < view_.num_nodes(); u++)
+        view_.weight(u) = dfg_->weight(u);
+    for (unsigned i = 0; i < num_candidates(); i++) {
+        double weight = 0;
+        for (auto u : candidate_nodes(i))
+            weight += view_.weight(u);
+        candidate_weights_[i] = weight;
+    }
+    sort_candidates();
+    for (auto &cluster : s_clusters_)
+        cluster.reweight(*dfg_);
+    last_search_ = nullptr;
+}
+
+void MVSFinder::update(const DFGDelta &delta)
+{
+    INTSET_PHASE("update");
+
+    // view_ still shares the index of the graph before the change
+    const DFG &old = view_;
+    int num_nodes = dfg_->num_nodes();
+
+    // P(u) changes only if a path from u to a forbidden node or from a
+    // forbidden node to u appears or disappears, or if the node is
+    // forbidden or allowed and is related to u. A new edge (a, b) only
+    // adds paths from the ancestors of a to the descendants of b.
+    intset affected(num_nodes);
+    intset touched(num_nodes);
+    for (auto edges : {&delta.added_edges, &delta.removed_edges}) {
+        for (auto &edge : *edges) {
+            touched.add(edge.first).add(edge.second);
+            for (const DFG *g : {&old, dfg_}) {
+                affected.add(edge.first).add(g->pred(edge.first));
+                affected.add(edge.second).add(g->succ(edge.second));
+            }
+        }
+    }
+    intset forbidden = dfg_->forbidden();
+    forbidden.remove(old.forbidden());
+    intset allowed = old.forbidden();
+    allowed.remove(dfg_->forbidden());
+    for (auto u : forbidden | allowed)
+        for (const DFG *g : {&old, dfg_})
+            affected.add(u).add(g->pred(u)).add(g->succ(u));
+    view_ = *dfg_;
+
+    // the other nodes keep their P sets, up to the nodes that are now
+    // forbidden or allowed and that are unrelated to them
+    auto v_clusters = std::move(v_clusters_);
+    v_clusters_.clear();
+    for (auto &cluster : v_clusters) {
+        intset P = cluster.P();
+        P.remove(forbidden).add(allowed);
+        for (auto u : cluster.nodes)
+            if (!affected.contains(u))
+                add_to_class(u, P);
+    }
+    intset P(num_nodes);
+    for (auto u : affected) {
+        if (dfg_->forbidden().contains(u))
+            continue;
+        p_set(*dfg_, u, P);
+        add_to_class(u, P);
+        P.clear();
+    }
+
+    // the search of a candidate depends only on its nodes and their
+    // edges
+    std::unordered_multimap<size_t, unsigned> index;
+    std::vector<intset> old_nodes;
+    std::vector<MVSResult> old_results;
+    for (unsigned i = 0; i < num_candidates(); i++) {
+        auto nodes = candidate_nodes(i);
+        if (!nodes.intersects(touched)) {
+            index.emplace(nodes.hash(), old_nodes.size());
+            old_nodes.push_back(std::move(nodes));
+            old_results.push_back(results_[i]);
+        }
+    }
+    find_candidates();
+    unsigned num_reused = 0;
+    for (unsigned i = 0; i < num_candidates(); i++) {
+        auto nodes = candidate_nodes(i);
+        auto range = index.equal_range(nodes.hash());
+        for (auto it = range.first; it != range.second; ++it) {
+            if (old_nodes[it->second] == nodes) {
+                results_[i] = old_results[it->second];
+                num_reused++;
+                break;
+            }
+        }
+    }
+
+    nlohmann::json json = {
+        {"num_affected", affected.size()},
+        {"num_reused", num_reused},
+    };
+    log_json(json);
 }
@@ -1,8 +1,14 @@
 #pragma once
 
+#include "automorphism.h"
 #include "cluster.h"
 #include "common.h"
 #include "dfg.h"
+#include "io.h"
+#include <chrono>
+#include <climits>
+#include <string>
+#include <vector>
 
 class VCluster {
 public:
@@ -20,15 +26,22 @@ private:
     intset P_;
 };
 
-class mvs : public IOSubgraph {
+// the outcome of the search of a candidate
+struct MVSResult {
+    bool disconnected = false;
+    int io_weight = 0;
+    // io_weight is exact if it is at least min_io_weight, otherwise the
+    // weight is below min_io_weight
+    int min_io_weight = INT_MAX;
+};
+
+class mvs : public IOSubgraph, public MVSResult {
 public:
-    mvs(const IOSubgraph &config)
+    mvs(const IOSubgraph &config, const MVSResult &result = {})
         : IOSubgraph(config)
+        , MVSResult(result)
     {
     }
-
-    bool disconnected = false;
-    int io_weight = 0;
 };
 
 class MVSFinder {
@@ -39,18 +52,45 @@ public:
         BINARY_SEARCH,
     };
 
-    MVSFinder(DFG *dfg);
+    MVSFinder(const DFG &dfg, std::ostream *log = &std::cerr);
+    MVSFinder(const MVSFinder &) = delete;
+    MVSFinder &operator=(const MVSFinder &) = delete;
+
     std::vector<IOSubgraph> enumerate(int max_num_in,
                                       int max_num_out,
                                       IterType itype,
                                       uint8_t flags);
     const intset &nodes() const { return config_.nodes(); }
+    // approximate number of bytes used by the finder
+    size_t memory_size() const;
+    // save the state of enumerate to 'path' every 'interval' seconds
+    void set_checkpoint(const std::string &path, double interval);
+    // continue the next call to enumerate from the state saved in 'path'
+    void resume(const std::string &path);
+    // solve one candidate of each orbit of the automorphism group of the
+    // graph and map its subgraphs to the other candidates of the orbit
+    void set_automorphisms(bool enable) { automorphisms_ = enable; }
+    // the graph passed to the constructor has been changed by delta:
+    // recompute the P sets of the nodes whose paths to forbidden nodes
+    // changed and the candidates, and keep the results of the previous
+    // call to enumerate for the candidates with the same nodes, inputs
+    // and outputs
+    void update(const DFGDelta &delta);
+    // the weights of the graph passed to the constructor have changed:
+    // the candidates and the clusters do not depend on them, only their
+    // weights and the results of enumerate do
+    void reweight();
 
 private:
     int find_best_recursion_node(int max_num_in,
                                  int max_num_out,
                                  int num_perm_in,
                                  int num_perm_out);
+    int enter(double dels,
+              bool single,
+              int &max_weight,
+              int max_num_in,
+              int max_num_out);
     void visit(double dels,
                bool single,
                int &max_weight,
@@ -66,29 +106,92 @@ private:
                     int max_io_weight,
                     int max_num_in,
                     int max_num_out);
+    void add_to_class(int u, const intset &P);
+    void find_candidates();
+    unsigned num_candidates() const { return candidate_weights_.size(); }
+    intset candidate_nodes(unsigned i) const;
+    mvs candidate(unsigned i) const;
+    void add_candidate(const intset &nodes, double weight);
+    void sort_candidates();
+    void find_orbits(std::vector<unsigned> &orbit,
+                     std::vector<Automorphisms::Permutation> &map);
     void link_cluster(const SCluster &cluster);
     void unlink_cluster(const SCluster &cluster);
 
-    DFG *dfg_;
+    const DFG *dfg_;
+    // private copy of the graph where S-clusters are contracted
+    DFG view_;
     std::vector<VCluster> v_clusters_;
     std::vector<SCluster> s_clusters_;
     std::vector<SCluster> s_nodes_;
-    std::vector<mvs> mvs_vec_;
+    // the candidates, stored compactly until the search reaches them:
+    // the sets of nodes one after another in candidate_blocks_, and
+    // the weights and the results of the search in parallel vectors
+    std::vector<intset::block> candidate_blocks_;
+    std::vector<double> candidate_weights_;
+    std::vector<MVSResult> results_;
     std::vector<IOSubgraph> *io_output_;
     IOSubgraph config_;
     IterType itype_;
     uint8_t flags_;
+    bool automorphisms_ = false;
     intset nodes_left_;
     intset clustered_;
     unsigned count_;
     unsigned calls_;
-    unsigned pruned_[3];
+    unsigned pruned_[4];
+    IOFlow flow_;
+    std::ostream *log_;
+
+    // a node of the search tree, before its first child, between its
+    // children or after its second child
+    struct Frame {
+        enum State { ENTER, FIRST, SECOND } state;
+        int id;
+        double dels;
+    };
+    std::vector<Frame> stack_;
+
+    // outcome of a call to visit
+    struct Visit {
+        double dels;
+        int max_weight;
+        unsigned count;
+        unsigned calls;
+        unsigned pruned[4];
+        std::vector<intset> subgraphs;
+    };
+    Visit make_visit(double dels, int max_weight, size_t first) const;
+    void restore_visit(const Visit &visit, double dels, int &max_weight);
+    void save_checkpoint(double dels, int max_weight, size_t first);
+
+    // a checkpoint stores the outcome of the completed calls to visit
+    // and the stack of the current one. A resumed enumerate replays the
+    // completed calls and continues the current one from its stack.
+    std::string checkpoint_path_;
+    double checkpoint_interval_ = 0;
+    std::chrono::steady_clock::time_point last_checkpoint_;
+    std::vector<Visit> visits_;
+    nlohmann::json search_;
+    // the search of the last call to enumerate, the results of the
+    // candidates are kept for the next call with the same search
+    nlohmann::json last_search_;
+    nlohmann::json resume_;
+    std::vector<Visit> replay_;
+    Visit replay_current_;
+    std::vector<Frame> replay_stack_;
+
+    void log_json(const nlohmann::json &json)
+    {
+        if (log_)
+            *log_ << json.dump() << std::endl;
+    }
 
     void reset_stats()
     {
         count_ = 0;
         calls_ = 0;
-        for (int i = 0; i < 3; i++)
+        for (int i = 0; i < 4; i++)
             pruned_[i] = 0;
     }
 
@@ -100,6 +203,9 @@ private:
             {"calls", calls_},
             {"pruned", pruned_},
         };
-        std::cerr << json.dump() << std::endl;
+        log_json(json);
     }
 };
+
+bool parse_flags(const std::string &str, uint8_t &flags);
+bool parse_itype(const std::string &str, MVSFinder::IterType &itype);
@@ -0,0 +1,191 @@
+/* Copyright (C) 2013-2026 Emanuele Giaquinta
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation; either version 2, or (at your option) any
+   later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#include "result.h"
+#include "common.h"
+#include "dfg.h"
+#include "intset.h"
+#include "nlohmann/json.hpp"
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static const char MAGIC[] = "MVSB";
+static const char VERSION = 1;
+enum Tag { END, LIST, BITSET };
+
+ResultWriter::ResultWriter(std::ostream &out, int num_nodes, bool io)
+    : out_(&out)
+    , num_nodes_(num_nodes)
+    , io_(io)
+{
+    buffer_.append(MAGIC, 4);
+    buffer_ += VERSION;
+    buffer_ += char(io);
+    put_varint(num_nodes, buffer_);
+}
+
+void ResultWriter::put_varint(unsigned v, std::string &out)
+{
+    while (v >= 0x80) {
+        out += char(v | 0x80);
+        v >>= 7;
+    }
+    out += char(v);
+}
+
+void ResultWriter::flush()
+{
+    out_->write(buffer_.data(), buffer_.size());
+    buffer_.clear();
+}
+
+void ResultWriter::write(const IOSubgraph &subgraph)
+{
+    auto &nodes = subgraph.nodes();
+    list_.clear();
+    put_varint(nodes.size(), list_);
+    int prev = -1;
+    for (auto u : nodes) {
+        put_varint(u - prev - 1, list_);
+        prev = u;
+    }
+    if (list_.size() < nodes.num_blocks() * sizeof(intset::block)) {
+        buffer_ += char(LIST);
+        buffer_ += list_;
+    } else {
+        buffer_ += char(BITSET);
+        for (unsigned i = 0; i < nodes.num_blocks(); i++)
+            for (unsigned j = 0; j < sizeof(intset::block); j++)
+                buffer_ += char(nodes.data()[i] >> (8 * j));
+    }
+    if (io_) {
+        for (auto list : {&subgraph.inputs(), &subgraph.outputs()}) {
+            put_varint(list->size(), buffer_);
+            for (auto &u : *list)
+                put_varint(u, buffer_);
+        }
+    }
+    if (buffer_.size() >= 1 << 16)
+        flush();
+}
+
+void ResultWriter::finish(const nlohmann::json &report)
+{
+    buffer_ += char(END);
+    auto text = report.dump();
+    put_varint(text.size(), buffer_);
+    buffer_ += text;
+    flush();
+    out_->flush();
+}
+
+ResultReader::ResultReader(std::istream &in)
+    : in_(&in)
+    , nodes_(0)
+{
+    char header[6];
+    if (!in.read(header, 6) || std::string(header, 4) != MAGIC ||
+        header[4] != VERSION)
+        throw std::runtime_error("invalid result file");
+    io_ = header[5] & 1;
+    num_nodes_ = get_varint();
+    nodes_ = intset(num_nodes_);
+}
+
+unsigned ResultReader::get_varint()
+{
+    unsigned v = 0;
+    for (unsigned shift = 0; shift < 32; shift += 7) {
+        int c = in_->get();
+        if (c == EOF)
+            throw std::runtime_error("truncated result file");
+        v |= unsigned(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return v;
+    }
+    throw std::runtime_error("invalid result file");
+}
+
+void ResultReader::get_list(std::vector<int> &list)
+{
+    list.resize(get_varint());
+    for (auto &u : list)
+        u = get_varint();
+}
+
+bool ResultReader::next()
+{
+    int tag = in_->get();
+    if (tag == END) {
+        std::string text(get_varint(), '\0');
+        if (!in_->read(&text[0], text.size()))
+            throw std::runtime_error("truncated result file");
+        report_ = nlohmann::json::parse(text);
+        return false;
+    }
+
+    nodes_.clear();
+    if (tag == LIST) {
+        unsigned size = get_varint();
+        long u = -1;
+        for (unsigned i = 0; i < size; i++) {
+            u += get_varint() + 1;
+            if (u >= num_nodes_)
+                throw std::runtime_error("invalid result file");
+            nodes_.add(u);
+        }
+    } else if (tag == BITSET) {
+        for (unsigned i = 0; i < nodes_.num_blocks(); i++) {
+            unsigned char bytes[sizeof(intset::block)];
+            if (!in_->read((char *)bytes, sizeof(bytes)))
+                throw std::runtime_error("truncated result file");
+            intset::block b = 0;
+            for (unsigned j = 0; j < sizeof(bytes); j++)
+                b |= intset::block(bytes[j]) << (8 * j);
+            nodes_.data()[i] = b;
+        }
+        unsigned tail = num_nodes_ % intset::bits_per_block;
+        if (tail && nodes_.data()[nodes_.num_blocks() - 1] >> tail)
+            throw std::runtime_error("invalid result file");
+    } else {
+        throw std::runtime_error(tag == EOF ? "truncated result file"
+                                            : "invalid result file");
+    }
+    if (io_) {
+        get_list(inputs_);
+        get_list(outputs_);
+    }
+    return true;
+}
+
+nlohmann::json read_result(std::istream &in)
+{
+    ResultReader reader(in);
+    auto subgraphs = nlohmann::json::array();
+    while (reader.next()) {
+        nlohmann::json subgraph = {{"nodes", reader.nodes()}};
+        if (reader.has_io()) {
+            subgraph["inputs"] = reader.inputs();
+            subgraph["outputs"] = reader.outputs();
+        }
+        subgraphs.push_back(std::move(subgraph));
+    }
+    auto report = reader.report();
+    report["subgraphs"] = std::move(subgraphs);
+    return report;
+}
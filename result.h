@@ -0,0 +1,65 @@
+#pragma once
+
+#include "dfg.h"
+#include "intset.h"
+#include <nlohmann/json.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Compact binary format of the output of mvs and vs. The header is the
+// magic "MVSB", a version byte, a flags byte (1 if the subgraphs have
+// inputs and outputs) and the number of nodes of the graph. Each
+// subgraph is a tag byte followed by its nodes, either as a list of
+// gaps between consecutive nodes (tag 1) or as the blocks of a bitset
+// (tag 2), whichever is shorter, and then by its inputs and outputs as
+// counted lists. A zero tag and the report of the run in JSON, without
+// the subgraphs, end the file. Integers are LEB128 varints, blocks are
+// little endian.
+class ResultWriter {
+public:
+    ResultWriter(std::ostream &out, int num_nodes, bool io);
+
+    void write(const IOSubgraph &subgraph);
+    void finish(const nlohmann::json &report);
+
+private:
+    void put_varint(unsigned v, std::string &out);
+    void flush();
+
+    std::ostream *out_;
+    int num_nodes_;
+    bool io_;
+    std::string buffer_;
+    std::string list_;
+};
+
+class ResultReader {
+public:
+    ResultReader(std::istream &in);
+
+    int num_nodes() const { return num_nodes_; }
+    bool has_io() const { return io_; }
+    // read the next subgraph, false at the end of the file
+    bool next();
+    const intset &nodes() const { return nodes_; }
+    const std::vector<int> &inputs() const { return inputs_; }
+    const std::vector<int> &outputs() const { return outputs_; }
+    // the report of the run, after next returns false
+    const nlohmann::json &report() const { return report_; }
+
+private:
+    unsigned get_varint();
+    void get_list(std::vector<int> &list);
+
+    std::istream *in_;
+    int num_nodes_;
+    bool io_;
+    intset nodes_;
+    std::vector<int> inputs_;
+    std::vector<int> outputs_;
+    nlohmann::json report_;
+};
+
+// the JSON output of mvs or vs for a file in the binary format
+nlohmann::json read_result(std::istream &in);
@@ -0,0 +1,365 @@
+/* Copyright (C) 2013-2026 Emanuele Giaquinta
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation; either version 2, or (at your option) any
+   later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#include "common.h"
+#include "dfg.h"
+#include "mvs.h"
+#include "nlohmann/json.hpp"
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// newline-delimited messages over a pair of file descriptors
+class Channel {
+public:
+    Channel(int in_fd, int out_fd)
+        : in_fd_(in_fd)
+        , out_fd_(out_fd)
+    {
+    }
+
+    bool read_line(std::string &line);
+    bool write_line(const std::string &line);
+
+private:
+    int in_fd_;
+    int out_fd_;
+    std::string buffer_;
+};
+
+bool Channel::read_line(std::string &line)
+{
+    for (;;) {
+        auto pos = buffer_.find('\n');
+        if (pos != std::string::npos) {
+            line = buffer_.substr(0, pos);
+            buffer_.erase(0, pos + 1);
+            return true;
+        }
+        char buf[4096];
+        ssize_t n = read(in_fd_, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            if (buffer_.empty())
+                return false;
+            line.swap(buffer_);
+            buffer_.clear();
+            return true;
+        }
+        buffer_.append(buf, n);
+    }
+}
+
+bool Channel::write_line(const std::string &line)
+{
+    std::string data = line + '\n';
+    size_t pos = 0;
+    while (pos < data.size()) {
+        ssize_t n = write(out_fd_, data.data() + pos, data.size() - pos);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return false;
+        pos += n;
+    }
+    return true;
+}
+
+struct Entry {
+    std::string key;
+    struct timespec mtime;
+    off_t size;
+    std::unique_ptr<DFG> dfg;
+    std::unique_ptr<MVSFinder> finder;
+    size_t memory;
+};
+
+// parsed and indexed graphs with their finders, evicted in least
+// recently used order when their memory exceeds the budget
+class Cache {
+public:
+    Cache(size_t budget)
+        : budget_(budget)
+    {
+    }
+
+    Entry &get(const std::string &path, bool use_weights, bool &hit);
+    // measure again the most recently used entry, whose finder grows
+    // with the searches, and evict the others over the budget
+    void update();
+    size_t memory() const { return memory_; }
+    size_t size() const { return entries_.size(); }
+
+private:
+    static size_t memory_size(const Entry &entry);
+    void evict();
+    void erase(std::list<Entry>::iterator it);
+
+    size_t budget_;
+    size_t memory_ = 0;
+    // most recently used first
+    std::list<Entry> entries_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+};
+
+Entry &Cache::get(const std::string &path, bool use_weights, bool &hit)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        throw std::runtime_error("cannot open file");
+
+    std::string key = path + (use_weights ? "\tw" : "");
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        auto &entry = *it->second;
+        if (entry.size == st.st_size &&
+            entry.mtime.tv_sec == st.st_mtim.tv_sec &&
+            entry.mtime.tv_nsec == st.st_mtim.tv_nsec) {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            hit = true;
+            return entries_.front();
+        }
+        erase(it->second);
+    }
+
+    hit = false;
+    std::ifstream input(path);
+    if (!input)
+        throw std::runtime_error("cannot open file");
+    Entry entry;
+    entry.key = key;
+    entry.mtime = st.st_mtim;
+    entry.size = st.st_size;
+    entry.dfg = DFG::make_dfg(input, use_weights);
+    if (entry.dfg->forbidden().size() != unsigned(entry.dfg->num_nodes()))
+        entry.finder = std::make_unique<MVSFinder>(*entry.dfg, nullptr);
+    entry.memory = memory_size(entry);
+
+    memory_ += entry.memory;
+    entries_.push_front(std::move(entry));
+    index_[key] = entries_.begin();
+    evict();
+    return entries_.front();
+}
+
+void Cache::update()
+{
+    auto &entry = entries_.front();
+    memory_ -= entry.memory;
+    entry.memory = memory_size(entry);
+    memory_ += entry.memory;
+    evict();
+}
+
+size_t Cache::memory_size(const Entry &entry)
+{
+    size_t size = entry.dfg->memory_size();
+    if (entry.finder)
+        size += entry.finder->memory_size();
+    return size;
+}
+
+// the most recently used entry is kept even if it exceeds the budget
+void Cache::evict()
+{
+    while (entries_.size() > 1 && memory_ > budget_)
+        erase(std::prev(entries_.end()));
+}
+
+void Cache::erase(std::list<Entry>::iterator it)
+{
+    memory_ -= it->memory;
+    index_.erase(it->key);
+    entries_.erase(it);
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+nlohmann::json handle_request(const std::string &line, Cache &cache)
+{
+    const auto start = std::chrono::steady_clock::now();
+    nlohmann::json request;
+    nlohmann::json response;
+    std::string path;
+    try {
+        request = nlohmann::json::parse(line);
+        path = request.at("graph").get<std::string>();
+        int max_num_in = request.at("max_in").get<int>();
+        int max_num_out = request.at("max_out").get<int>();
+        if (max_num_in < 0 || max_num_out < 0)
+            throw std::runtime_error("invalid threshold");
+
+        auto options = request.value("options", nlohmann::json::object());
+        bool use_weights = options.value("weights", false);
+        uint8_t flags = 0xff;
+        if (options.contains("disable") &&
+            !parse_flags(options["disable"].get<std::string>(), flags))
+            throw std::runtime_error("invalid optimization list");
+        MVSFinder::IterType itype = MVSFinder::IterType::LINEAR_REV;
+        if (options.contains("iteration") &&
+            !parse_itype(options["iteration"].get<std::string>(), itype))
+            throw std::runtime_error("invalid iteration type");
+
+        bool hit;
+        Entry &entry = cache.get(path, use_weights, hit);
+        const auto solve_start = std::chrono::steady_clock::now();
+        std::vector<IOSubgraph> output;
+        if (entry.finder) {
+            output =
+                entry.finder->enumerate(max_num_in, max_num_out, itype, flags);
+            cache.update();
+        }
+
+        response = {
+            {"cached", hit},
+            {"max_weight", !output.empty() ? output[0].weight() : 0},
+            {"name", entry.dfg->name()},
+            {"num_nodes", entry.dfg->num_nodes()},
+            {"num_subgraphs", output.size()},
+            {"subgraphs", output},
+            {"time", seconds_since(solve_start)},
+        };
+    } catch (const std::exception &e) {
+        response = {
+            {"error", e.what()},
+        };
+    }
+    if (request.is_object() && request.contains("id"))
+        response["id"] = request["id"];
+    response["latency"] = seconds_since(start);
+
+    nlohmann::json json = {
+        {"cache_entries", cache.size()},
+        {"cache_memory", cache.memory()},
+        {"graph", path},
+        {"latency", response["latency"]},
+    };
+    std::cerr << json.dump() << std::endl;
+    return response;
+}
+
+void serve(Channel &channel, Cache &cache)
+{
+    std::string line;
+    while (channel.read_line(line)) {
+        if (line.empty())
+            continue;
+        if (!channel.write_line(handle_request(line, cache).dump()))
+            break;
+    }
+}
+
+int listen_unix(const std::string &path)
+{
+    struct sockaddr_un addr;
+    if (path.size() >= sizeof(addr.sun_path))
+        return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+    unlink(path.c_str());
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, 16) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    std::string socket_path;
+    int budget = 1024;
+
+    int c;
+    while ((c = getopt(argc, argv, "hm:S:")) != -1) {
+        switch (c) {
+            case 'm':
+                if (!parse_integer(std::string(optarg), budget, 1, INT_MAX)) {
+                    fprintf(stderr, "invalid memory budget\n");
+                    return 1;
+                }
+                break;
+            case 'S':
+                socket_path = optarg;
+                break;
+            default:
+                fprintf(stdout,
+                        "Usage: mvs-server [OPTIONS]\n"
+                        "  -m MB\t\t\tset the cache memory budget\n"
+                        "  -S PATH\t\tlisten on a Unix socket instead of "
+                        "standard input\n");
+                return 1;
+        }
+    }
+
+    Cache cache(size_t(budget) << 20);
+    if (socket_path.empty()) {
+        Channel channel(STDIN_FILENO, STDOUT_FILENO);
+        serve(channel, cache);
+        return 0;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    int listen_fd = listen_unix(socket_path);
+    if (listen_fd < 0) {
+        fprintf(stderr, "cannot listen on %s\n", socket_path.c_str());
+        return 1;
+    }
+    for (;;) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        Channel channel(fd, fd);
+        serve(channel, cache);
+        close(fd);
+    }
+    close(listen_fd);
+    return 1;
+}
@@ -0,0 +1,244 @@
+/* Copyright (C) 2013-2026 Emanuele Giaquinta
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation; either version 2, or (at your option) any
+   later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#include "split.h"
+#include "common.h"
+#include "nlohmann/json.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+std::vector<intset> independent_groups(const DFG &dfg)
+{
+    int n = dfg.num_nodes();
+    auto forbidden = dfg.forbidden();
+    intset allowed(n);
+    for (int u = 0; u < n; u++)
+        if (!forbidden.contains(u))
+            allowed.add(u);
+
+    std::vector<int> parent(n);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&parent](int u) {
+        while (parent[u] != u)
+            u = parent[u] = parent[parent[u]];
+        return u;
+    };
+    auto join = [&parent, &find](int u, int v) { parent[find(u)] = find(v); };
+
+    // a path between two allowed nodes, through forbidden nodes or not
+    for (auto u : allowed) {
+        intset succ = dfg.succ(u);
+        for (auto v : succ.intersect(allowed))
+            join(u, v);
+    }
+    // a forbidden node that is an input of two allowed nodes
+    for (auto u : forbidden) {
+        int first = -1;
+        for (auto &v : dfg.out_edges(u)) {
+            if (!allowed.contains(v))
+                continue;
+            if (first == -1)
+                first = v;
+            else
+                join(first, v);
+        }
+    }
+
+    std::vector<intset> groups;
+    std::unordered_map<int, int> index;
+    for (auto u : allowed) {
+        auto it = index.emplace(find(u), groups.size()).first;
+        if (it->second == groups.size())
+            groups.emplace_back(n);
+        groups[it->second].add(u);
+    }
+    return groups;
+}
+
+static bool is_max(double weight, double max_weight)
+{
+    return max_weight <= weight || fp_eq(weight, max_weight, 0.01);
+}
+
+SplitFinder::SplitFinder(const DFG &dfg,
+                         unsigned num_threads,
+                         std::ostream *log)
+    : dfg_(&dfg)
+    , num_threads_(std::max(num_threads, 1u))
+    , log_(log)
+{
+    int n = dfg.num_nodes();
+    for (auto &nodes : independent_groups(dfg)) {
+        // the nodes between two nodes of the group and the neighbors of
+        // the group are needed to check convexity and count inputs and
+        // outputs, they are all forbidden
+        intset pred(n);
+        intset succ(n);
+        intset keep = nodes;
+        for (auto u : nodes) {
+            pred.add(dfg.pred(u));
+            succ.add(dfg.succ(u));
+            for (auto &v : dfg.in_edges(u))
+                keep.add(v);
+            for (auto &v : dfg.out_edges(u))
+                keep.add(v);
+        }
+        keep.add(pred.intersect(succ));
+
+        std::vector<int> map(n, -1);
+        int num_nodes = 0;
+        for (auto u : keep)
+            map[u] = num_nodes++;
+        Group group;
+        group.graph = std::make_unique<MappedDFG>(dfg, map);
+        assert(group.graph->dfg().num_nodes() -
+                   group.graph->dfg().forbidden().size() ==
+               nodes.size());
+        groups_.push_back(std::move(group));
+    }
+}
+
+void SplitFinder::solve(Group &group,
+                        int max_num_in,
+                        int max_num_out,
+                        MVSFinder::IterType itype,
+                        uint8_t flags)
+{
+    MVSFinder finder(group.graph->dfg(), nullptr);
+    group.weight.assign(max_num_in + 1,
+                        std::vector<double>(max_num_out + 1, 0));
+    group.subgraphs.assign(max_num_in + 1,
+                           std::vector<std::vector<intset>>(max_num_out + 1));
+    for (int i = 1; i <= max_num_in; i++) {
+        for (int o = 1; o <= max_num_out; o++) {
+            auto output = finder.enumerate(i, o, itype, flags);
+            double &weight = group.weight[i][o];
+            for (auto &subgraph : output)
+                weight = std::max(weight, subgraph.weight());
+            for (auto &subgraph : output)
+                if (subgraph.num_in() == i && subgraph.num_out() == o &&
+                    is_max(subgraph.weight(), weight))
+                    group.subgraphs[i][o].push_back(
+                        group.graph->expand(subgraph.nodes()));
+        }
+    }
+}
+
+std::vector<IOSubgraph> SplitFinder::enumerate(int max_num_in,
+                                               int max_num_out,
+                                               MVSFinder::IterType itype,
+                                               uint8_t flags)
+{
+    if (groups_.size() == 1) {
+        MVSFinder finder(*dfg_, log_);
+        return finder.enumerate(max_num_in, max_num_out, itype, flags);
+    }
+
+    // the largest groups first
+    std::vector<unsigned> order(groups_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(
+        order.begin(), order.end(), [this](unsigned g1, unsigned g2) {
+            return groups_[g1].graph->dfg().num_nodes() >
+                   groups_[g2].graph->dfg().num_nodes();
+        });
+    std::atomic<unsigned> next(0);
+    auto worker = [&]() {
+        for (unsigned i; (i = next++) < order.size();)
+            solve(groups_[order[i]], max_num_in, max_num_out, itype, flags);
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < std::min<size_t>(num_threads_, order.size()); i++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &thread : threads)
+        thread.join();
+
+    // allocate the inputs and outputs among the groups
+    unsigned k = groups_.size();
+    best_.assign(k + 1,
+                 std::vector<std::vector<double>>(
+                     max_num_in + 1, std::vector<double>(max_num_out + 1, 0)));
+    for (int g = k - 1; g >= 0; g--)
+        for (int i = 0; i <= max_num_in; i++)
+            for (int o = 0; o <= max_num_out; o++) {
+                double &best = best_[g][i][o];
+                best = best_[g + 1][i][o];
+                for (int a = 1; a <= i; a++)
+                    for (int b = 1; b <= o; b++)
+                        best = std::max(best,
+                                        groups_[g].weight[a][b] +
+                                            best_[g + 1][i - a][o - b]);
+            }
+
+    nlohmann::json json = {
+        {"max_weight", best_[0][max_num_in][max_num_out]},
+        {"num_groups", k},
+    };
+    if (log_)
+        *log_ << json.dump() << std::endl;
+
+    std::vector<IOSubgraph> output;
+    if (best_[0][max_num_in][max_num_out] > 0) {
+        intset nodes(dfg_->num_nodes());
+        combine(0,
+                max_num_in,
+                max_num_out,
+                best_[0][max_num_in][max_num_out],
+                nodes,
+                output);
+    }
+    return output;
+}
+
+// every union of maximum subgraphs of groups g.. with at most num_in
+// inputs and num_out outputs whose weight is 'weight'
+void SplitFinder::combine(unsigned g,
+                          int num_in,
+                          int num_out,
+                          double weight,
+                          intset &nodes,
+                          std::vector<IOSubgraph> &output)
+{
+    if (g == groups_.size()) {
+        output.emplace_back(*dfg_, intset(nodes));
+        return;
+    }
+    if (is_max(best_[g + 1][num_in][num_out], weight))
+        combine(g + 1, num_in, num_out, weight, nodes, output);
+    auto &group = groups_[g];
+    for (int a = 1; a <= num_in; a++)
+        for (int b = 1; b <= num_out; b++) {
+            double w = group.weight[a][b];
+            if (group.subgraphs[a][b].empty() ||
+                !is_max(w + best_[g + 1][num_in - a][num_out - b], weight))
+                continue;
+            for (auto &subgraph : group.subgraphs[a][b]) {
+                nodes.add(subgraph);
+                combine(g + 1,
+                        num_in - a,
+                        num_out - b,
+                        weight - w,
+                        nodes,
+                        output);
+                nodes.remove(subgraph);
+            }
+        }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "dfg.h"
+#include "intset.h"
+#include "mvs.h"
+#include "transform.h"
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// groups of allowed nodes such that no path connects two groups and no
+// node is an input of two groups. The union of subgraphs of different
+// groups is a subgraph whose inputs and outputs are the union of their
+// inputs and outputs.
+std::vector<intset> independent_groups(const DFG &dfg);
+
+// finds the maximum subgraphs of each independent group in a separate
+// graph, and combines them
+class SplitFinder {
+public:
+    SplitFinder(const DFG &dfg,
+                unsigned num_threads,
+                std::ostream *log = &std::cerr);
+
+    std::vector<IOSubgraph> enumerate(int max_num_in,
+                                      int max_num_out,
+                                      MVSFinder::IterType itype,
+                                      uint8_t flags);
+    int num_groups() const { return groups_.size(); }
+
+private:
+    struct Group {
+        std::unique_ptr<MappedDFG> graph;
+        // weight[i][o] is the weight of the maximum subgraphs with at
+        // most i inputs and o outputs, subgraphs[i][o] are the maximum
+        // subgraphs with exactly i inputs and o outputs
+        std::vector<std::vector<double>> weight;
+        std::vector<std::vector<std::vector<intset>>> subgraphs;
+    };
+
+    void solve(Group &group,
+               int max_num_in,
+               int max_num_out,
+               MVSFinder::IterType itype,
+               uint8_t flags);
+    void combine(unsigned g,
+                 int num_in,
+                 int num_out,
+                 double weight,
+                 intset &nodes,
+                 std::vector<IOSubgraph> &output);
+
+    const DFG *dfg_;
+    unsigned num_threads_;
+    std::ostream *log_;
+    std::vector<Group> groups_;
+    // best[g][i][o] is the weight of the maximum subgraph of groups g..
+    // with at most i inputs and o outputs
+    std::vector<std::vector<std::vector<double>>> best_;
+};
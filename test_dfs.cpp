@@ -1,6 +1,125 @@
+#include "cluster.h"
 #include "dfg.h"
+#include "vs.h"
+#include <algorithm>
 #include <cassert>
 #include <list>
+#include <numeric>
+#include <random>
+#include <tuple>
+#include <vector>
+
+// compare the index with the nodes reachable by a DFS from each node,
+// on a random graph large enough to be indexed in several tiles when
+// there are several threads
+static void test_index(int n, int num_edges)
+{
+    std::mt19937 rng(n);
+    std::vector<int> perm(n);
+    std::iota(perm.begin(), perm.end(), 0);
+    std::shuffle(perm.begin(), perm.end(), rng);
+    DFG dfg("random", n, 0);
+    std::uniform_int_distribution<int> node(0, n - 1);
+    for (int i = 0; i < num_edges; i++) {
+        int u = node(rng);
+        int v = node(rng);
+        if (u != v)
+            dfg.add_edge(perm[std::min(u, v)], perm[std::max(u, v)]);
+    }
+    dfg.index();
+
+    std::vector<intset> pred(n, intset(n));
+    for (int u = 0; u < n; u++) {
+        intset succ(n);
+        std::vector<int> stack {u};
+        while (!stack.empty()) {
+            int v = stack.back();
+            stack.pop_back();
+            for (auto &w : dfg.out_edges(v))
+                if (!succ.contains(w)) {
+                    succ.add(w);
+                    pred[w].add(u);
+                    stack.push_back(w);
+                }
+        }
+        assert(dfg.succ(u) == succ);
+    }
+    for (int u = 0; u < n; u++)
+        assert(dfg.pred(u) == pred[u]);
+}
+
+using SClusterKey = std::tuple<int,
+                               int,
+                               std::vector<std::pair<int, double>>,
+                               std::vector<std::pair<int, int>>>;
+
+static std::vector<SClusterKey> keys(const std::vector<SCluster> &clusters)
+{
+    std::vector<SClusterKey> out;
+    for (auto &cluster : clusters)
+        out.emplace_back(
+            cluster.dst(), cluster.src(), cluster.nodes(), cluster.edges());
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+// compare the S-clusters with the maximal subgraphs with one input and
+// one output found by vs_enumerate, on a random sparse graph with some
+// forbidden nodes
+static void test_scluster(int n, int num_edges, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    DFG dfg("random", n, 0);
+    std::uniform_int_distribution<int> node(0, n - 1);
+    for (int i = 0; i < num_edges; i++) {
+        int u = node(rng);
+        int v = std::min(n - 1, u + 1 + int(rng() % 4));
+        if (u != v)
+            dfg.add_edge(u, v);
+    }
+    for (int i = 0; i < n / 10; i++)
+        dfg.set_forbidden(node(rng));
+    dfg.index();
+
+    std::vector<intset> subgraphs;
+    vs_enumerate(dfg, 1, 1, [&subgraphs](const IOSubgraph &subgraph) {
+        if (subgraph.nodes().size() == 1)
+            return;
+        for (auto it = subgraphs.begin(); it != subgraphs.end();) {
+            if (subgraph.nodes().is_subset_of(*it))
+                return;
+            if (it->is_subset_of(subgraph.nodes()))
+                it = subgraphs.erase(it);
+            else
+                it++;
+        }
+        subgraphs.push_back(subgraph.nodes());
+    });
+    std::vector<SCluster> expected;
+    for (auto &subgraph : subgraphs) {
+        std::vector<std::pair<int, double>> nodes;
+        std::vector<std::pair<int, int>> edges;
+        int vi = -1;
+        int vo = -1;
+        for (auto u : subgraph) {
+            for (auto &v : dfg.out_edges(u)) {
+                if (subgraph.contains(v))
+                    edges.emplace_back(u, v);
+                else
+                    vo = u;
+            }
+            if (u != vo)
+                nodes.emplace_back(u, dfg.weight(u));
+            for (auto &v : dfg.in_edges(u))
+                if (!subgraph.contains(v)) {
+                    edges.emplace_back(v, u);
+                    vi = v;
+                }
+        }
+        expected.emplace_back(std::move(nodes), std::move(edges), vi, vo);
+    }
+    assert(keys(scluster_enumerate(dfg)) == keys(expected));
+}
 
 int main()
 {
@@ -20,4 +139,12 @@ int main()
     DFSVisitor(dfg, [&order](int u) { order.push_front(u); });
     std::list<int> topo_order {1, 6, 5, 3, 0, 4, 2};
     assert(topo_order == order);
+
+    test_index(100, 300);
+    test_index(10000, 15000);
+    // dense enough to transpose the succ sets
+    test_index(3000, 30000);
+
+    for (unsigned seed = 0; seed < 200; seed++)
+        test_scluster(40 + seed % 40, 50 + seed % 60, seed);
 }
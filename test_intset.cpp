@@ -35,6 +35,13 @@ int main()
     for (const auto &elem : s) {
         assert(elements[elem]);
     }
+    intset even(256);
+    unsigned num_even = 0;
+    for (i = 0; i < 256; i += 2) {
+        even.add(i);
+        num_even += elements[i];
+    }
+    assert(s.intersection_size(even) == num_even);
     for (i = 0; i < 256; i++)
         s.remove(i);
     assert(s.minimum() == -1);
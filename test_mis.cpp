@@ -17,6 +17,11 @@ static void test(Graph &graph, unsigned count)
 {
     find_mis<MISFinder>(graph, count);
     find_mis<MISFinderBK>(graph, count);
+    find_mis<MISFinderTomita>(graph, count);
+    Graph copy = graph;
+    copy.set_dense(!graph.is_dense());
+    find_mis<MISFinder>(copy, count);
+    find_mis<MISFinderBK>(copy, count);
 }
 
 int main()
@@ -41,4 +46,12 @@ int main()
     graph.invert();
     assert(graph.num_edges() == 18);
     test(graph, 5);
+
+    // a cycle across two blocks, the other nodes are isolated; the
+    // number of maximal independent sets of a cycle of 20 nodes is the
+    // Perrin number P(20)
+    Graph cycle(80);
+    for (int i = 0; i < 20; i++)
+        cycle.add_edge(50 + i, 50 + (i + 1) % 20);
+    test(cycle, 277);
 }
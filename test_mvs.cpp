@@ -1,13 +1,111 @@
 #include "common.h"
 #include "dfg.h"
 #include "mvs.h"
+#include "result.h"
+#include "split.h"
+#include "transform.h"
+#include <algorithm>
 #include <cassert>
 #include <climits>
+#include <cstdio>
+#include <cstdlib>
 #include <cstdint>
 #include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// a and b have the same subgraphs, in any order
+static void assert_same(const std::vector<IOSubgraph> &a,
+                        const std::vector<IOSubgraph> &b)
+{
+    assert(a.size() == b.size());
+    for (auto &mvs : a)
+        assert(std::any_of(b.begin(), b.end(), [&mvs](const IOSubgraph &s) {
+            return s.nodes() == mvs.nodes();
+        }));
+}
+
+// on this graph, with unit weights, a maximum subgraph with two inputs
+// and two outputs is disconnected only if the s-node that is removed
+// from it counts with its weight
+static void test_disconnected()
+{
+    DFG dfg = {
+        {0, 1},
+        {0, 2},
+        {1, 3},
+        {1, 4},
+        {1, 7},
+        {1, 9},
+        {2, 3},
+        {3, 6},
+        {4, 5},
+        {5, 6},
+        {6, 8},
+        {9, 10},
+    };
+    dfg.set_forbidden(0);
+    dfg.set_forbidden(7);
+    dfg.index();
+
+    // the finder logs the decision
+    std::ostringstream log;
+    MVSFinder finder(dfg, &log);
+    auto output =
+        finder.enumerate(2, 2, MVSFinder::IterType::LINEAR_REV, 0xff);
+    assert(output.size() == 2);
+    assert(log.str().find("\"connected\":false") != std::string::npos);
+}
 
 int main(int argc, char **argv)
 {
+    bool reduce = false;
+    bool renumber = false;
+    bool split = false;
+    bool checkpoint = false;
+    bool binary = false;
+    bool automorphisms = false;
+    bool update = false;
+    bool reweight = false;
+    int c;
+    while ((c = getopt(argc, argv, "abcknRru")) != -1) {
+        switch (c) {
+            case 'a':
+                automorphisms = true;
+                break;
+            case 'b':
+                binary = true;
+                break;
+            case 'c':
+                split = true;
+                break;
+            case 'k':
+                checkpoint = true;
+                break;
+            case 'n':
+                renumber = true;
+                break;
+            case 'R':
+                reweight = true;
+                break;
+            case 'r':
+                reduce = true;
+                break;
+            case 'u':
+                update = true;
+                break;
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
+
+    if (argc == 1) {
+        test_disconnected();
+        return 0;
+    }
     if (argc != 5)
         return 1;
     int max_num_in;
@@ -21,9 +119,122 @@ int main(int argc, char **argv)
         return 1;
     std::ifstream input(argv[1]);
     auto dfg = DFG::make_dfg(input, false);
-    auto finder = MVSFinder(dfg.get());
+    std::unique_ptr<MappedDFG> reduced;
+    if (reduce)
+        reduced = MappedDFG::reduce(*dfg);
+    std::unique_ptr<MappedDFG> renumbered;
+    if (renumber)
+        renumbered = MappedDFG::renumber(reduced ? reduced->dfg() : *dfg);
+    const DFG &graph = renumbered ? renumbered->dfg()
+                       : reduced  ? reduced->dfg()
+                                  : *dfg;
     auto itype = MVSFinder::IterType::LINEAR_REV;
     uint8_t flags = 0xff;
-    auto output = finder.enumerate(max_num_in, max_num_out, itype, flags);
+    std::vector<IOSubgraph> output;
+    // a unique file, removed at the end of the test
+    std::string checkpoint_path;
+    if (checkpoint) {
+        const char *dir = getenv("TMPDIR");
+        checkpoint_path = std::string(dir ? dir : "/tmp") + "/test_mvs.XXXXXX";
+        int fd = mkstemp(&checkpoint_path[0]);
+        if (fd == -1)
+            return 1;
+        close(fd);
+    }
+    if (split) {
+        SplitFinder finder(graph, 2);
+        output = finder.enumerate(max_num_in, max_num_out, itype, flags);
+    } else {
+        MVSFinder finder(graph);
+        if (checkpoint)
+            finder.set_checkpoint(checkpoint_path, 0);
+        finder.set_automorphisms(automorphisms);
+        output = finder.enumerate(max_num_in, max_num_out, itype, flags);
+        if (update) {
+            // forbid a node of the first subgraph, remove an edge from
+            // a node of the last one and add an edge from it to one of
+            // its descendants. The updated finder finds the same
+            // subgraphs as a new one.
+            DFGDelta delta;
+            delta.forbidden.push_back(output.front().nodes().minimum());
+            int u = output.back().nodes().minimum();
+            if (!dfg->out_edges(u).empty())
+                delta.removed_edges.emplace_back(u, dfg->out_edges(u)[0]);
+            auto &edges = dfg->out_edges(u);
+            for (auto v : dfg->succ(u)) {
+                if (std::find(edges.begin(), edges.end(), v) == edges.end()) {
+                    delta.added_edges.emplace_back(u, v);
+                    break;
+                }
+            }
+            dfg->apply(delta);
+            finder.update(delta);
+            auto updated =
+                finder.enumerate(max_num_in, max_num_out, itype, flags);
+            MVSFinder fresh(*dfg);
+            assert_same(
+                fresh.enumerate(max_num_in, max_num_out, itype, flags),
+                updated);
+        }
+        if (reweight) {
+            // the same for new weights
+            for (int u = 0; u < dfg->num_nodes(); u++)
+                dfg->weight(u) = 1 + u % 3;
+            finder.reweight();
+            auto reweighted =
+                finder.enumerate(max_num_in, max_num_out, itype, flags);
+            MVSFinder fresh(*dfg);
+            assert_same(
+                fresh.enumerate(max_num_in, max_num_out, itype, flags),
+                reweighted);
+        }
+    }
+    if (automorphisms) {
+        // the subgraphs mapped from the first candidate of each orbit
+        // are those found by solving every candidate
+        MVSFinder finder(graph);
+        assert_same(finder.enumerate(max_num_in, max_num_out, itype, flags),
+                    output);
+    }
+    if (checkpoint) {
+        // a search resumed from the last checkpoint finds the same
+        // subgraphs
+        MVSFinder finder(graph);
+        finder.resume(checkpoint_path);
+        auto resumed =
+            finder.enumerate(max_num_in, max_num_out, itype, flags);
+        assert(resumed.size() == output.size());
+        for (size_t i = 0; i < output.size(); i++)
+            assert(resumed[i].nodes() == output[i].nodes());
+        std::remove(checkpoint_path.c_str());
+        std::remove((checkpoint_path + ".tmp").c_str());
+    }
+    if (renumbered)
+        output = renumbered->expand(output);
+    if (reduced)
+        output = reduced->expand(output);
     assert(output.size() == output_size);
+    if (binary) {
+        // the subgraphs read back from the binary format are the same
+        std::stringstream stream;
+        ResultWriter writer(stream, dfg->num_nodes(), true);
+        for (auto &subgraph : output)
+            writer.write(subgraph);
+        writer.finish({{"num_subgraphs", output.size()}});
+        ResultReader reader(stream);
+        for (auto &subgraph : output) {
+            assert(reader.next());
+            assert(reader.nodes() == subgraph.nodes());
+            assert(std::equal(reader.inputs().begin(),
+                              reader.inputs().end(),
+                              subgraph.inputs().begin(),
+                              subgraph.inputs().end()));
+            assert(std::equal(reader.outputs().begin(),
+                              reader.outputs().end(),
+                              subgraph.outputs().begin(),
+                              subgraph.outputs().end()));
+        }
+        assert(!reader.next());
+        assert(reader.report()["num_subgraphs"] == output.size());
+    }
 }
@@ -0,0 +1,50 @@
+#include "nlohmann/json.hpp"
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// send a malformed request and then a valid one to the server on the
+// same stream: the first gets an error, the second is solved
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+        return 1;
+    const char *dir = getenv("TMPDIR");
+    std::string path = std::string(dir ? dir : "/tmp") + "/test_server.XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd == -1)
+        return 1;
+    std::vector<nlohmann::json> requests = {
+        {{"graph", 5}, {"max_in", 2}, {"max_out", 1}, {"id", 1}},
+        {{"graph", argv[2]}, {"max_in", 2}, {"max_out", 1}, {"id", 2}},
+    };
+    std::string text;
+    for (auto &request : requests)
+        text += request.dump() + "\n";
+    bool ok = write(fd, text.data(), text.size()) == ssize_t(text.size());
+    close(fd);
+
+    std::string command =
+        std::string(argv[1]) + " < " + path + " 2> /dev/null";
+    FILE *server = ok ? popen(command.c_str(), "r") : nullptr;
+    std::vector<nlohmann::json> responses;
+    if (server) {
+        char *line = nullptr;
+        size_t size = 0;
+        while (getline(&line, &size, server) != -1)
+            responses.push_back(nlohmann::json::parse(line));
+        free(line);
+        ok = pclose(server) == 0;
+    }
+    unlink(path.c_str());
+    if (!ok)
+        return 1;
+
+    assert(responses.size() == 2);
+    assert(responses[0]["id"] == 1 && responses[0].contains("error"));
+    assert(responses[1]["id"] == 2 && !responses[1].contains("error"));
+    assert(responses[1]["num_subgraphs"].get<int>() > 0);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "intset.h"
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// undo log for the sets of a backtracking search: each update records
+// the blocks it changes, and undo restores them in reverse order, so
+// that backtracking costs as much as the updates it reverts
+class Trail {
+public:
+    // position of the log to pass to undo
+    size_t mark() const { return log_.size(); }
+
+    // revert the updates made after mark
+    void undo(size_t mark)
+    {
+        while (log_.size() > mark) {
+            auto &entry = log_.back();
+            *entry.first = entry.second;
+            log_.pop_back();
+        }
+    }
+
+    void add(intset &s, unsigned n)
+    {
+        set(s.data()[n / intset::bits_per_block],
+            s.data()[n / intset::bits_per_block] | mask(n));
+    }
+
+    void add(intset &s, const intset &t)
+    {
+        assert(s.max_size() == t.max_size());
+        auto data = s.data();
+        for (unsigned i = 0; i < s.num_blocks(); i++)
+            set(data[i], data[i] | t.data()[i]);
+    }
+
+    void remove(intset &s, unsigned n)
+    {
+        set(s.data()[n / intset::bits_per_block],
+            s.data()[n / intset::bits_per_block] & ~mask(n));
+    }
+
+    void remove(intset &s, const intset &t)
+    {
+        assert(s.max_size() == t.max_size());
+        auto data = s.data();
+        for (unsigned i = 0; i < s.num_blocks(); i++)
+            set(data[i], data[i] & ~t.data()[i]);
+    }
+
+private:
+    static intset::block mask(unsigned n)
+    {
+        return intset::block(1) << (n % intset::bits_per_block);
+    }
+
+    void set(intset::block &b, intset::block value)
+    {
+        if (b == value)
+            return;
+        log_.emplace_back(&b, b);
+        b = value;
+    }
+
+    std::vector<std::pair<intset::block *, intset::block>> log_;
+};
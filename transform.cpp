@@ -0,0 +1,138 @@
+/* Copyright (C) 2013-2026 Emanuele Giaquinta
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation; either version 2, or (at your option) any
+   later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.  */
+
+#include "transform.h"
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <vector>
+
+// map[u] is the node of the new graph that contains node u of the
+// original graph, or -1 if u is removed. A node of the new graph is
+// forbidden if it contains a forbidden node.
+MappedDFG::MappedDFG(const DFG &original, const std::vector<int> &map)
+    : original_(&original)
+{
+    assert(map.size() == original.num_nodes());
+    int num_nodes = 0;
+    for (auto &v : map)
+        num_nodes = std::max(num_nodes, v + 1);
+    dfg_ = std::make_unique<DFG>(
+        original.name(), num_nodes, original.frequency());
+    nodes_.resize(num_nodes);
+
+    auto forbidden = original.forbidden();
+    for (int u = 0; u < original.num_nodes(); u++) {
+        int v = map[u];
+        if (v == -1)
+            continue;
+        if (nodes_[v].empty())
+            dfg_->weight(v) = 0;
+        nodes_[v].push_back(u);
+        dfg_->weight(v) += original.weight(u);
+        if (forbidden.contains(u))
+            dfg_->set_forbidden(v);
+        for (auto &w : original.out_edges(u))
+            if (map[w] != -1 && map[w] != v)
+                dfg_->add_edge(v, map[w]);
+    }
+    dfg_->index();
+}
+
+std::unique_ptr<MappedDFG> MappedDFG::reduce(const DFG &dfg)
+{
+    int n = dfg.num_nodes();
+    auto forbidden = dfg.forbidden();
+    intset allowed(n);
+    for (int u = 0; u < n; u++)
+        if (!forbidden.contains(u))
+            allowed.add(u);
+
+    // a forbidden node matters only if it is an input or the successor
+    // of an output of some subgraph, or if it lies on a path between
+    // two nodes of a subgraph
+    std::vector<bool> removed(n);
+    for (auto u : forbidden) {
+        bool adjacent = false;
+        for (auto &v : dfg.in_edges(u))
+            adjacent = adjacent || allowed.contains(v);
+        for (auto &v : dfg.out_edges(u))
+            adjacent = adjacent || allowed.contains(v);
+        removed[u] = !adjacent && !(dfg.pred(u).intersects(allowed) &&
+                                    dfg.succ(u).intersects(allowed));
+    }
+
+    // if u is the only predecessor of v and v is the only successor of
+    // u, a subgraph with u and not v (or vice versa) has at least the
+    // same inputs and outputs as the subgraph with both, so a maximum
+    // subgraph contains either both nodes or none when their weight is
+    // positive
+    std::vector<int> next(n, -1);
+    for (auto u : allowed) {
+        if (dfg.in_edges(u).size() != 1 || dfg.out_edges(u).size() != 1 ||
+            dfg.weight(u) <= 0)
+            continue;
+        int v = *dfg.out_edges(u).begin();
+        if (allowed.contains(v) && dfg.in_edges(v).size() == 1 &&
+            dfg.weight(v) > 0)
+            next[u] = v;
+    }
+
+    // each chain is contracted into its last node
+    std::vector<int> map(n, -1);
+    int num_nodes = 0;
+    for (int u = 0; u < n; u++)
+        if (!removed[u] && next[u] == -1)
+            map[u] = num_nodes++;
+    for (int u = 0; u < n; u++) {
+        int v = u;
+        while (next[v] != -1)
+            v = next[v];
+        if (v != u)
+            map[u] = map[v];
+    }
+    return std::make_unique<MappedDFG>(dfg, map);
+}
+
+// in the reverse DFS post-order, the nodes reachable from a node first
+// reached by the DFS follow it, so the pred and succ sets of nearby
+// nodes share most of their blocks
+std::unique_ptr<MappedDFG> MappedDFG::renumber(const DFG &dfg)
+{
+    int n = dfg.num_nodes();
+    std::vector<int> map(n);
+    int num_nodes = n;
+    DFSVisitor visitor(dfg,
+                       [&map, &num_nodes](int u) { map[u] = --num_nodes; });
+    return std::make_unique<MappedDFG>(dfg, map);
+}
+
+intset MappedDFG::expand(const intset &nodes) const
+{
+    intset out(original_->num_nodes());
+    for (auto u : nodes)
+        for (auto &v : nodes_[u])
+            out.add(v);
+    return out;
+}
+
+std::vector<IOSubgraph>
+MappedDFG::expand(const std::vector<IOSubgraph> &subgraphs) const
+{
+    std::vector<IOSubgraph> out;
+    for (auto &subgraph : subgraphs)
+        out.emplace_back(*original_, expand(subgraph.nodes()));
+    return out;
+}
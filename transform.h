@@ -0,0 +1,33 @@
+#pragma once
+
+#include "dfg.h"
+#include "intset.h"
+#include <memory>
+#include <vector>
+
+// a graph derived from another graph, where each node stands for one
+// or more nodes of the original graph
+class MappedDFG {
+public:
+    MappedDFG(const DFG &original, const std::vector<int> &map);
+
+    // reduced graph where forbidden nodes that do not affect any
+    // subgraph are removed and chains of allowed nodes are merged
+    static std::unique_ptr<MappedDFG> reduce(const DFG &dfg);
+    // copy of the graph with the nodes numbered in topological order
+    static std::unique_ptr<MappedDFG> renumber(const DFG &dfg);
+
+    const DFG &original() const { return *original_; }
+    const DFG &dfg() const { return *dfg_; }
+    const std::vector<int> &nodes(int u) const { return nodes_[u]; }
+
+    intset expand(const intset &nodes) const;
+    std::vector<IOSubgraph>
+    expand(const std::vector<IOSubgraph> &subgraphs) const;
+
+private:
+    const DFG *original_;
+    std::unique_ptr<DFG> dfg_;
+    // nodes of the original graph of each node
+    std::vector<std::vector<int>> nodes_;
+};
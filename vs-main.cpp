@@ -16,6 +16,7 @@
 #include "common.h"
 #include "dfg.h"
 #include "nlohmann/json.hpp"
+#include "result.h"
 #include "vs.h"
 #include <chrono>
 #include <climits>
@@ -30,10 +31,18 @@ int main(int argc, char *argv[])
 {
     bool enum_all = false;
     bool use_weights = false;
+    bool binary = false;
+    bool binary_io = false;
 
     int c;
-    while ((c = getopt(argc, argv, "ew:")) != -1) {
+    while ((c = getopt(argc, argv, "bBew:")) != -1) {
         switch (c) {
+            case 'b':
+                binary = true;
+                break;
+            case 'B':
+                binary = binary_io = true;
+                break;
             case 'e':
                 enum_all = true;
                 break;
@@ -48,6 +57,8 @@ int main(int argc, char *argv[])
     if (argc < 3) {
         fprintf(stdout,
                 "Usage: vs [OPTIONS] MAX-IN MAX-OUT\n"
+                "  -b\t\t\twrite the subgraphs in binary format\n"
+                "  -B\t\t\tsame as -b, with inputs and outputs\n"
                 "  -e\t\t\tenumerate all\n"
                 "  -w\t\t\tuse real weights\n");
         return 1;
@@ -72,20 +83,34 @@ int main(int argc, char *argv[])
     double max_weight = 0;
     const auto start = std::chrono::steady_clock::now();
     std::vector<IOSubgraph> output;
-    vs_enumerate(*dfg,
-                 max_num_in,
-                 max_num_out,
-                 [&max_weight, &output, enum_all](const IOSubgraph &subgraph) {
-                     double weight = subgraph.weight();
-                     if (enum_all || weight >= max_weight) {
-                         if (!fp_eq(weight, max_weight, 0.01)) {
-                             max_weight = weight;
-                             if (!enum_all)
-                                 output.clear();
-                         }
-                     }
-                     output.emplace_back(subgraph);
-                 });
+    std::unique_ptr<ResultWriter> writer;
+    if (binary)
+        writer = std::make_unique<ResultWriter>(
+            std::cout, dfg->num_nodes(), binary_io);
+    // all the subgraphs are written as they are found
+    bool stream = enum_all && writer;
+    size_t num_subgraphs = 0;
+    vs_enumerate(
+        *dfg,
+        max_num_in,
+        max_num_out,
+        [&max_weight, &output, &writer, &num_subgraphs, enum_all, stream](
+            const IOSubgraph &subgraph) {
+            double weight = subgraph.weight();
+            if (enum_all || weight >= max_weight) {
+                if (!fp_eq(weight, max_weight, 0.01)) {
+                    max_weight = weight;
+                    if (!enum_all)
+                        output.clear();
+                }
+            }
+            if (stream) {
+                writer->write(subgraph);
+                num_subgraphs++;
+            } else {
+                output.emplace_back(subgraph);
+            }
+        });
     const auto end = std::chrono::steady_clock::now();
     const std::chrono::duration<double> elapsed = end - start;
 
@@ -93,11 +118,17 @@ int main(int argc, char *argv[])
         {"max_weight", max_weight},
         {"name", dfg->name()},
         {"num_nodes", dfg->num_nodes()},
-        {"num_subgraphs", output.size()},
-        {"subgraphs", output},
+        {"num_subgraphs", stream ? num_subgraphs : output.size()},
         {"time", elapsed.count()},
     };
-    std::cout << report.dump(4) << std::endl;
+    if (writer) {
+        for (auto &subgraph : output)
+            writer->write(subgraph);
+        writer->finish(report);
+    } else {
+        report["subgraphs"] = output;
+        std::cout << report.dump(4) << std::endl;
+    }
 
     return 0;
 }
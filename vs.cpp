@@ -20,10 +20,6 @@
 
 static const bool VERIFY = false;
 
-// implementation of the algorithm for subgraph enumeration under
-// convexity, input and output constraints described in
-// https://doi.org/10.1109/CSE.2009.167
-
 static bool verify_config(const DFG &dfg, const IOSubgraph &config)
 {
     if (config.nodes().intersects(dfg.forbidden()))
@@ -32,38 +28,74 @@ static bool verify_config(const DFG &dfg, const IOSubgraph &config)
     return config.nodes() == config.closure();
 }
 
-static intset config_exclusion(const DFG &dfg, const intset &config)
+intset config_exclusion(const DFG &dfg, const intset &config)
 {
-    intset out(dfg.forbidden());
-
-    for (int b = dfg.num_nodes() - 1; b >= 0; b--)
-        if (out.contains(b))
-            for (auto &a : dfg.in_edges(b)) {
-                if (a < dfg.num_nodes() && !config.contains(a))
-                    out.add(a);
-            }
+    Exclusion exclusion(dfg);
+    for (auto u : config)
+        exclusion.add_output(u);
+    return exclusion.nodes();
+}
 
-    return out;
+// a node is excluded if it is forbidden, or if it is not an output and
+// has an excluded successor. Since the graph is acyclic, counting the
+// excluded successors of each node is enough to update the set.
+Exclusion::Exclusion(const DFG &dfg)
+    : dfg_(&dfg)
+    , outputs_(dfg.num_nodes())
+    , nodes_(dfg.forbidden())
+    , count_(dfg.num_nodes())
+{
+    for (auto u : nodes_)
+        queue_.push_back(u);
+    propagate();
 }
 
-class VSFinder {
-public:
-    VSFinder(const DFG &dfg, const Subgraph &outputs)
-        : config_(dfg, outputs.closure())
-        , F_(config_exclusion(dfg, outputs.nodes()))
-    {
+// update the count of the predecessors of the nodes in the queue, which
+// entered or left the set
+void Exclusion::propagate()
+{
+    while (!queue_.empty()) {
+        int b = queue_.back();
+        queue_.pop_back();
+        bool added = nodes_.contains(b);
+        for (auto &a : dfg_->in_edges(b)) {
+            if (a >= dfg_->num_nodes())
+                continue;
+            count_[a] += added ? 1 : -1;
+            if (outputs_.contains(a) || dfg_->forbidden().contains(a))
+                continue;
+            if (added && !nodes_.contains(a)) {
+                nodes_.add(a);
+                queue_.push_back(a);
+            } else if (!added && count_[a] == 0 && nodes_.contains(a)) {
+                nodes_.remove(a);
+                queue_.push_back(a);
+            }
+        }
     }
+}
 
-    void visit(int max_num_in,
-               const std::function<void(const IOSubgraph &)> &output_cb);
+void Exclusion::add_output(int u)
+{
+    outputs_.add(u);
+    if (nodes_.contains(u) && !dfg_->forbidden().contains(u)) {
+        nodes_.remove(u);
+        queue_.push_back(u);
+        propagate();
+    }
+}
 
-private:
-    IOSubgraph config_;
-    intset F_;
-};
+void Exclusion::remove_output(int u)
+{
+    outputs_.remove(u);
+    if (count_[u] > 0 && !nodes_.contains(u)) {
+        nodes_.add(u);
+        queue_.push_back(u);
+        propagate();
+    }
+}
 
-void VSFinder::visit(int max_num_in,
-                     const std::function<void(const IOSubgraph &)> &output_cb)
+int VSFinder::num_perm_in() const
 {
     const DFG &dfg = config_.dfg();
     int num_perm_in = 0;
@@ -71,78 +103,37 @@ void VSFinder::visit(int max_num_in,
         if (u >= dfg.num_nodes() || F_.contains(u))
             num_perm_in++;
     }
+    return num_perm_in;
+}
 
-    if (num_perm_in > max_num_in)
-        return;
-
+int VSFinder::next_node() const
+{
     int id = -1;
-    auto pred = config_.pred();
-    for (const auto &u : pred) {
+    for (auto u : config_.pred()) {
         if (!F_.contains(u))
             id = u;
     }
-
-    if (id == -1) {
-        output_cb(config_);
-
-        if (VERIFY)
-            assert(verify_config(dfg, config_));
-
-        return;
-    }
-
-    config_.add(id);
-    visit(max_num_in, output_cb);
-
-    config_.remove(id);
-    intset F_prev(F_);
-    F_.add(id);
-    F_.add(dfg.pred(id));
-    visit(max_num_in, output_cb);
-    F_ = F_prev;
+    return id;
 }
 
-namespace {
-
-void vs_enumerate_(const DFG &dfg,
-                   Subgraph &outputs,
-                   int size,
-                   int max_num_in,
-                   int max_num_out,
-                   const std::function<void(const IOSubgraph &)> &output_cb)
+void VSFinder::verify() const
 {
-    if (size >= 1) {
-        VSFinder finder(dfg, outputs);
-        finder.visit(max_num_in, output_cb);
-    }
-    if (size < max_num_out) {
-        auto exclusion = config_exclusion(dfg, outputs.nodes());
-        auto pred = outputs.pred();
-        intset valid(dfg.num_nodes());
-        for (const auto &u : exclusion) {
-            if (!dfg.is_forbidden(u) &&
-                !(pred.contains(u) && dfg.succ(u).intersects(pred, exclusion)))
-                valid.add(u);
-        }
-
-        unsigned min = outputs.nodes().minimum();
-        for (int u = 0; u < dfg.num_nodes(); u++) {
-            if (min != -1 && u >= min)
-                break;
-            if (valid.contains(u)) {
-                outputs.add(u);
-                vs_enumerate_(dfg,
-                              outputs,
-                              size + 1,
-                              max_num_in,
-                              max_num_out,
-                              output_cb);
-                outputs.remove(u);
-            }
-        }
-    }
+    if (VERIFY)
+        assert(verify_config(config_.dfg(), config_.subgraph()));
 }
 
+intset VSFinder::valid_outputs(const DFG &dfg,
+                               const TrackedSubgraph &outputs,
+                               const intset &exclusion)
+{
+    auto &pred = outputs.pred();
+    intset valid(dfg.num_nodes());
+    for (const auto &u : exclusion) {
+        if (!dfg.is_forbidden(u) &&
+            !(pred.contains(u) && dfg.succ(u).intersects(pred, exclusion)))
+            valid.add(u);
+    }
+    return valid;
 }
 
 void vs_enumerate(const DFG &dfg,
@@ -150,6 +141,8 @@ void vs_enumerate(const DFG &dfg,
                   int max_num_out,
                   const std::function<void(const IOSubgraph &)> &output_cb)
 {
-    Subgraph outputs(dfg);
-    vs_enumerate_(dfg, outputs, 0, max_num_in, max_num_out, output_cb);
+    TrackedSubgraph outputs(dfg);
+    Exclusion exclusion(dfg);
+    VSFinder::enumerate(
+        dfg, outputs, exclusion, 0, max_num_in, max_num_out, output_cb);
 }
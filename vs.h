@@ -1,6 +1,187 @@
 #pragma once
 
 #include "dfg.h"
+#include "intset.h"
+#include "trail.h"
+#include <functional>
+#include <vector>
+
+// implementation of the algorithm for subgraph enumeration under
+// convexity, input and output constraints described in
+// https://doi.org/10.1109/CSE.2009.167
+
+// nodes that cannot be added to a subgraph with outputs 'config'
+intset config_exclusion(const DFG &dfg, const intset &config);
+
+// the nodes that cannot be added to a subgraph with a set of outputs:
+// the forbidden nodes and the nodes with a path to a forbidden node
+// that does not pass through an output. The set is updated when an
+// output is added or removed, in time proportional to the nodes that
+// enter or leave it and their edges.
+class Exclusion {
+public:
+    Exclusion(const DFG &dfg);
+
+    void add_output(int u);
+    void remove_output(int u);
+    const intset &nodes() const { return nodes_; }
+
+private:
+    void propagate();
+
+    const DFG *dfg_;
+    intset outputs_;
+    intset nodes_;
+    // number of successors of each node in nodes_
+    std::vector<int> count_;
+    // nodes that entered or left nodes_, whose predecessors must be
+    // updated
+    std::vector<int> queue_;
+};
+
+// The search takes the type of the callback as template parameter, so
+// that the callback can be inlined.
+class VSFinder {
+public:
+    VSFinder(const DFG &dfg,
+             const TrackedSubgraph &outputs,
+             const intset &exclusion)
+        : config_(dfg, outputs.closure())
+        , F_(exclusion)
+    {
+        // each level of the search adds a predecessor of the subgraph
+        // to it or to F_
+        stack_.reserve(dfg.num_nodes() + 1);
+    }
+
+    template <typename OutputCb>
+    void visit(int max_num_in, OutputCb &output_cb);
+
+    // enumerate the subgraphs whose outputs extend 'outputs' with
+    // nodes lower than its minimum
+    template <typename OutputCb>
+    static void enumerate(const DFG &dfg,
+                          TrackedSubgraph &outputs,
+                          Exclusion &exclusion,
+                          int size,
+                          int max_num_in,
+                          int max_num_out,
+                          OutputCb &output_cb);
+
+private:
+    int num_perm_in() const;
+    int next_node() const;
+    void verify() const;
+    static intset valid_outputs(const DFG &dfg,
+                                const TrackedSubgraph &outputs,
+                                const intset &exclusion);
+
+    TrackedSubgraph config_;
+    intset F_;
+
+    // a node of the search tree, before its first child, between its
+    // children or after its second child
+    struct Frame {
+        enum State { ENTER, FIRST, SECOND } state;
+        int id;
+        // trail_ before the second child
+        size_t mark;
+    };
+    std::vector<Frame> stack_;
+    // updates of F_ by the second child of the nodes on the stack
+    Trail trail_;
+};
+
+// depth-first search with an explicit stack: the first child of a node
+// adds a node to the subgraph, the second child excludes it
+template <typename OutputCb>
+void VSFinder::visit(int max_num_in, OutputCb &output_cb)
+{
+    stack_.push_back({Frame::ENTER, -1, 0});
+    while (!stack_.empty()) {
+        Frame &frame = stack_.back();
+        switch (frame.state) {
+            case Frame::ENTER:
+                if (num_perm_in() > max_num_in) {
+                    stack_.pop_back();
+                    break;
+                }
+
+                frame.id = next_node();
+                if (frame.id == -1) {
+                    output_cb(config_.subgraph());
+                    verify();
+                    stack_.pop_back();
+                    break;
+                }
+
+                config_.add(frame.id);
+                frame.state = Frame::FIRST;
+                stack_.push_back({Frame::ENTER, -1, 0});
+                break;
+            case Frame::FIRST:
+                config_.remove(frame.id);
+                frame.mark = trail_.mark();
+                trail_.add(F_, frame.id);
+                trail_.add(F_, config_.dfg().pred(frame.id));
+                frame.state = Frame::SECOND;
+                stack_.push_back({Frame::ENTER, -1, 0});
+                break;
+            case Frame::SECOND:
+                trail_.undo(frame.mark);
+                stack_.pop_back();
+                break;
+        }
+    }
+}
+
+template <typename OutputCb>
+void VSFinder::enumerate(const DFG &dfg,
+                         TrackedSubgraph &outputs,
+                         Exclusion &exclusion,
+                         int size,
+                         int max_num_in,
+                         int max_num_out,
+                         OutputCb &output_cb)
+{
+    if (size >= 1) {
+        VSFinder finder(dfg, outputs, exclusion.nodes());
+        finder.visit(max_num_in, output_cb);
+    }
+    if (size < max_num_out) {
+        auto valid = valid_outputs(dfg, outputs, exclusion.nodes());
+        unsigned min = outputs.nodes().minimum();
+        for (int u = 0; u < dfg.num_nodes(); u++) {
+            if (min != -1 && u >= min)
+                break;
+            if (valid.contains(u)) {
+                outputs.add(u);
+                exclusion.add_output(u);
+                enumerate(dfg,
+                          outputs,
+                          exclusion,
+                          size + 1,
+                          max_num_in,
+                          max_num_out,
+                          output_cb);
+                exclusion.remove_output(u);
+                outputs.remove(u);
+            }
+        }
+    }
+}
+
+template <typename OutputCb>
+void vs_enumerate(const DFG &dfg,
+                  int max_num_in,
+                  int max_num_out,
+                  OutputCb &&output_cb)
+{
+    TrackedSubgraph outputs(dfg);
+    Exclusion exclusion(dfg);
+    VSFinder::enumerate(
+        dfg, outputs, exclusion, 0, max_num_in, max_num_out, output_cb);
+}
 
 void vs_enumerate(const DFG &dfg,
                   int max_num_in,